@@ -7,6 +7,24 @@ LIB_SEARCH_PATH="$LUA_LIB_PATH /usr/local/lib/liblua.a /usr/local/lib/liblua-5.4
 JIT_LIB_SEARCH_PATH="$LUA_LIB_PATH /usr/local/lib/libluajit-5.1.a /mingw64/lib/libluajit-5.1.a /mingw64/lib/libluajit-5.1.dll.a"
 SO_EXT="so"
 
+if [ "$BENCH" = "true" ]; then
+  mkdir -p bin
+  ${CC:-gcc} -DGUS_EXE -DGUS_BENCH i.gus/src/*.c -O3 -march=native -lm -lrt -lpthread -o bin/gus-bench
+  exit $?
+fi
+
+if [ "$BOOK" = "true" ]; then
+  mkdir -p bin
+  ${CC:-gcc} -DGUS_EXE -DGUS_BOOKGEN i.gus/src/*.c -O3 -march=native -lm -lrt -lpthread -o bin/gus-book
+  exit $?
+fi
+
+if [ "$PERFT" = "true" ]; then
+  mkdir -p bin
+  ${CC:-gcc} -DGUS_EXE -DGUS_PERFT i.gus/src/*.c -O3 -march=native -lm -lrt -lpthread -o bin/gus-perft
+  exit $?
+fi
+
 if [ "$JIT" = "true" ]; then
   INC_SEARCH_PATH="$JIT_INC_SEARCH_PATH"
 fi
@@ -57,11 +75,11 @@ CC="${CC:-gcc}"
 mkdir -p bin
 
 DEFINES=""
-LIBS="-lm -ldl -lpthread"
+LIBS="-lm -ldl -lrt -lpthread"
 
 if [ "$(uname -o)" = "Msys" ]; then
   SO_EXT="dll"
-  LIBS=$(echo "$LIBS" | sed "s/-ldl//g")
+  LIBS=$(echo "$LIBS" | sed "s/-ldl//g" | sed "s/-lrt//g")
 fi
 
 if [ "$DEBUG" = "true" ]; then
@@ -73,6 +91,10 @@ if [ "$JIT" = "true" ]; then
   DEFINES="$DEFINES -DS80_JIT=1"
 fi
 
+if [ "$RELEASE" = "true" ]; then
+  DEFINES="$DEFINES -DGUS_NO_STATS"
+fi
+
 LUA_INC=$(echo "$LUA_INC" | sed 's/lua.h//g')
 
 FLAGS="$FLAGS -march=native -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast"
@@ -85,7 +107,7 @@ echo "Lua include directory: $LUA_INC"
 echo "Lua library directory: $LUA_LIB"
 
 DEFINES="$DEFINES -DS80_DYNAMIC=1"
-$CC i.gus/src/ai.c i.gus/src/main.c \
+$CC i.gus/src/ai.c i.gus/src/bitboard.c i.gus/src/tt.c i.gus/src/mcts.c i.gus/src/alphabeta.c i.gus/src/pool.c i.gus/src/arena.c i.gus/src/async.c i.gus/src/cache.c i.gus/src/book.c i.gus/src/ponder.c i.gus/src/pattern.c i.gus/src/score.c i.gus/src/tactics.c i.gus/src/stats.c i.gus/src/main.c \
     -shared -fPIC \
     $LUA_LIB \
     "-I$LUA_INC" \
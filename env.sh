@@ -1,2 +1,11 @@
 export PUBLIC_HTML=i.gus/
-export SALT=GusAI
\ No newline at end of file
+export SALT=GusAI
+export GUS_TT_MB=16
+export GUS_THREADS=1
+export GUS_ASYNC_THREADS=1
+export GUS_CACHE_MB=64
+export GUS_SLA_MS=0
+export GUS_PATTERNS=
+export GUS_BOOK=
+export GUS_PONDER=0
+export GUS_VERBOSE=0
\ No newline at end of file
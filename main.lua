@@ -1,17 +1,42 @@
 local aio = require("aio.aio")
 
-MAX_BOARD = MAX_BOARD or 13
+MAX_BOARD = MAX_BOARD or 19
 
 --- @class gus
 --- @field new fun(size: integer): lightuserdata
 --- @field free fun(board: lightuserdata)
---- @field place fun(board: lightuserdata, x: integer, y: integer, predict: boolean, pass: boolean): integer, integer, integer
---- @field encode fun(board: lightuserdata): string
+--- @field place fun(board: lightuserdata, x: integer, y: integer, predict: boolean, pass: boolean, search: {engine: string?, playouts: integer?, time_ms: integer?, nodes: integer?}?): integer, integer, integer, {nodes: integer, depth: integer, elapsed_ms: number}
+--- @field place_async fun(elfd: lightuserdata, board: lightuserdata, x: integer, y: integer, predict: boolean, pass: boolean, search: {engine: string?, playouts: integer?, time_ms: integer?, nodes: integer?}?): lightuserdata?, lightuserdata?
+--- @field collect fun(handle: lightuserdata, wait: boolean?): integer?, integer?, integer?, {nodes: integer, depth: integer, elapsed_ms: number}?
+--- @field score fun(board: lightuserdata, dead: boolean?): {black: integer, white: integer, dame: integer, dead_black: integer, dead_white: integer, komi: number, margin: number}
+--- @field encode fun(board: lightuserdata, format: "text"|"binary"|nil): string
 --- @field decode fun(text: string): lightuserdata
+--- @field tt_stats fun(): {entries: integer, probes: integer, hits: integer, stores: integer, saved_ratings: integer, saved_nodes: integer}
+--- @field cache_stats fun(): {buckets: integer, probes: integer, hits: integer, stores: integer, evictions: integer}
+--- @field stats fun(): table? counters of the native engine, nil when built with GUS_NO_STATS
 gus = gus or {}
 
 local salt = os.getenv("SALT") or "GusAI"
 
+local engines = { beam = true, mcts = true, alphabeta = true }
+local ERR_PASS = -5
+local max_playouts = 20000
+local max_time_ms = 2000
+local max_nodes = 10000000
+-- hard per request search budget, caps or replaces the requested time_ms when set
+local sla_ms = tonumber(os.getenv("GUS_SLA_MS") or "0") or 0
+
+-- phases timed on the Lua side, the native ones come from gus.stats()
+local lua_phases = { hmac = { count = 0, seconds = 0 } }
+
+local function sign(data)
+    local started = os.clock()
+    local signature = codec.hex_encode(crypto.hmac_sha256(data, salt))
+    lua_phases.hmac.count = lua_phases.hmac.count + 1
+    lua_phases.hmac.seconds = lua_phases.hmac.seconds + os.clock() - started
+    return signature
+end
+
 aio:set_max_cache_size(100000)
 
 aio:http_post("/gus/go", function (self, query, headers, body)
@@ -22,6 +47,12 @@ aio:http_post("/gus/go", function (self, query, headers, body)
     local board = nil
     local predict = false
     local pass = false
+    local search = {
+        engine = params.engine or "beam",
+        playouts = tonumber(params.playouts),
+        time_ms = tonumber(params.time_ms),
+        nodes = tonumber(params.nodes)
+    }
     
     if size == nil or size > MAX_BOARD then
         self:http_response("400 Bad request", "application/json", { error = "board size is too big" })
@@ -32,45 +63,145 @@ aio:http_post("/gus/go", function (self, query, headers, body)
     elseif not x or not y then
         self:http_response("400 Bad request", "application/json", { error = "invalid move" })
         return
+    elseif not engines[search.engine] then
+        self:http_response("400 Bad request", "application/json", { error = "unknown engine" })
+        return
+    elseif (search.playouts and search.playouts > max_playouts) or (search.time_ms and search.time_ms > max_time_ms)
+        or (search.nodes and search.nodes > (search.engine == "mcts" and max_playouts or max_nodes)) then
+        self:http_response("400 Bad request", "application/json", { error = "search budget is too big" })
+        return
+    end
+
+    if sla_ms > 0 and (not search.time_ms or search.time_ms <= 0 or search.time_ms > sla_ms) then
+        search.time_ms = sla_ms
     end
 
-    local key = string.format("%s:%s:%d:%d", params.session, params.signature, params.x, params.y)
+    local key = string.format("%s:%s:%d:%d:%s:%d:%d:%d", params.session, params.signature, params.x, params.y, search.engine, search.playouts or 0, search.time_ms or 0, search.nodes or 0)
 
-    local result = aio:cached("go", key, function ()
-        if params.session == "new" and size ~= nil then
-            board = gus.new(size)
-        else
-            if codec.hex_encode(crypto.hmac_sha256(params.session, salt)) ~= (params.signature or "xxx") then
-                return { error = "invalid signature", http_status = "400 Bad request" }
-            end
-            board = gus.decode(params.session)
-            predict = true
+    -- answered requests are cached once their search is done, a miss stores nothing
+    local cached = aio:cached("go", key, function () return nil end)
+    if cached then
+        self:http_response(cached.http_status, "application/json", cached)
+        return
+    end
+
+    local function respond(result)
+        aio:cached("go", key, function () return result end)
+        self:http_response(result.http_status, "application/json", result)
+    end
+
+    if params.session == "new" and size ~= nil then
+        board = gus.new(size)
+    else
+        if sign(params.session) ~= (params.signature or "xxx") then
+            respond({ error = "invalid signature", http_status = "400 Bad request" })
+            return
         end
-        if not board then
-            return nil
+        board = gus.decode(params.session)
+        predict = true
+    end
+    if not board then
+        self:http_response("500 Internal server error", "application/json", {error = "oom"})
+        return
+    end
+    if x == -2 then pass = true end
+
+    local function finish(status, x, y, stats)
+        local encoded = gus.encode(board, "binary")
+        if predict and status >= 0 then
+            -- think on the opponent's time, the next request of this game is likely answered from it
+            gus.ponder(board, search)
         end
-        if x == -2 then pass = true end
-        local status = 0
-        if x ~= nil and y ~= nil then
-            status, x, y = gus.place(board, x, y, predict, pass)
-        end 
-        local encoded = gus.encode(board)
         local response = {
             http_status = "200 OK",
             session = encoded,
-            signature = codec.hex_encode(crypto.hmac_sha256(encoded, salt)),
+            signature = sign(encoded),
             status = status,
             x = x,
-            y = y
+            y = y,
+            search = predict and stats or nil,
+            -- both sides passed, the game is over and counted by area
+            score = (pass and status == ERR_PASS) and gus.score(board) or nil
         }
         gus.free(board)
-        return response
-    end)
+        respond(response)
+    end
 
-    if not result then
-        self:http_response("500 Internal server error", "application/json", {error = "oom"})
-        return
+    -- the search runs on a native thread while this worker serves other requests,
+    -- the event loop reports the job's fd readable once the result can be collected
+    local handle, fd = gus.place_async(self.elfd, board, x, y, predict, pass, search)
+    if not handle then
+        finish(gus.place(board, x, y, predict, pass, search))
+    elseif not fd then
+        finish(gus.collect(handle, true))
+    else
+        aio.fds[fd] = {
+            on_data = function ()
+                local status, x, y, stats = gus.collect(handle)
+                if status == nil then return end
+                aio.fds[fd] = nil
+                finish(status, x, y, stats)
+            end,
+            on_close = function ()
+                aio.fds[fd] = nil
+                finish(gus.collect(handle, true))
+            end
+        }
+    end
+end)
+
+-- Prometheus text format, every worker process reports its own counters
+aio:http_get("/gus/metrics", function (self, query, headers, body)
+    local lines = {}
+    local function metric(name, kind, help, samples)
+        lines[#lines + 1] = string.format("# HELP gus_%s %s", name, help)
+        lines[#lines + 1] = string.format("# TYPE gus_%s %s", name, kind)
+        for _, sample in ipairs(samples) do
+            lines[#lines + 1] = string.format("gus_%s%s %s", name, sample[1], tostring(sample[2]))
+        end
+    end
+    local function labeled(label, values, scale)
+        local samples = {}
+        for key, value in pairs(values) do
+            samples[#samples + 1] = { string.format('{%s="%s"}', label, key), value * (scale or 1) }
+        end
+        table.sort(samples, function (a, b) return a[1] < b[1] end)
+        return samples
+    end
+
+    local stats = gus.stats()
+    if stats then
+        metric("places_total", "counter", "stones placed, including rejected moves", { { "", stats.places } })
+        metric("place_errors_total", "counter", "placements rejected by reason", labeled("reason", stats.place_errors))
+        metric("refreshes_total", "counter", "full board_refresh passes", { { "", stats.refreshes } })
+        metric("board_copies_total", "counter", "board copies", { { "", stats.copies } })
+        metric("ratings_total", "counter", "positions rated", { { "", stats.ratings } })
+        metric("candidates_total", "counter", "candidate moves generated", { { "", stats.candidates } })
+        metric("candidate_errors_total", "counter", "candidate moves rejected by reason", labeled("reason", stats.candidate_errors))
+        metric("allocations_total", "counter", "native heap allocations", { { "", stats.allocations } })
+        metric("ponder_probes_total", "counter", "searches that looked for a pondered reply", { { "", stats.ponder_probes } })
+        metric("ponder_hits_total", "counter", "searches answered by pondering", { { "", stats.ponder_hits } })
+        metric("tactics_reads_total", "counter", "capture readings of weak groups", { { "", stats.tactics_reads } })
+        metric("tactics_hits_total", "counter", "capture readings answered by the reading cache", { { "", stats.tactics_hits } })
+        local nodes = {}
+        for depth, count in ipairs(stats.nodes) do
+            nodes[#nodes + 1] = { string.format('{depth="%d"}', depth), count }
+        end
+        metric("search_nodes_total", "counter", "nodes searched by plies below the root", nodes)
+        metric("searches_total", "counter", "searches by engine", labeled("engine", stats.searches))
+        metric("search_seconds_total", "counter", "search wall time by engine", labeled("engine", stats.search_us, 1e-6))
+        metric("phase_total", "counter", "native request phases", labeled("phase", stats.phases))
+        metric("phase_seconds_total", "counter", "native request phase wall time", labeled("phase", stats.phase_us, 1e-6))
+    end
+    local counts, seconds = {}, {}
+    for phase, totals in pairs(lua_phases) do
+        counts[phase] = totals.count
+        seconds[phase] = totals.seconds
     end
-    local status = result.http_status
-    self:http_response(status, "application/json", result)
-end)
\ No newline at end of file
+    metric("lua_phase_total", "counter", "Lua request phases", labeled("phase", counts))
+    metric("lua_phase_cpu_seconds_total", "counter", "Lua request phase CPU time", labeled("phase", seconds))
+    local cache = gus.cache_stats()
+    metric("cache_hits_total", "counter", "shared position cache hits", { { "", cache.hits } })
+    metric("cache_probes_total", "counter", "shared position cache probes", { { "", cache.probes } })
+    self:http_response("200 OK", "text/plain; version=0.0.4", table.concat(lines, "\n") .. "\n")
+end)
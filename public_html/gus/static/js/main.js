@@ -10,6 +10,40 @@ const   NO_ERR = 0,
         ERR_KO = -4,
         ERR_PASS = -5;
 
+const SESSION_VERSION = 1,
+      SESSION_HEADER = 9;
+
+/**
+ * Decode session into scores (in tenths) and board state
+ * @param {String} session text session or base64url binary session
+ * @returns {{blackScore: Number, whiteScore: Number, state: Number[]}}
+ */
+function decodeSession(session) {
+    if(/^[0-9]/.test(session)) {
+        const params = session.split(" ")
+        return {
+            blackScore: parseFloat(params[3]),
+            whiteScore: parseFloat(params[4]),
+            state: params[5].split("").map(a => {
+                if(a == "+") return EMPTY;
+                else if(a == "X") return BLACK;
+                else return WHITE;
+            })
+        }
+    }
+    const raw = atob(session.replace(/-/g, "+").replace(/_/g, "/"));
+    const byte = (i) => raw.charCodeAt(i);
+    const word = (i) => { const v = byte(i) | (byte(i + 1) << 8); return v > 32767 ? v - 65536 : v; }
+    const size = byte(1) & 31;
+    const state = [];
+    if(byte(0) != (0x80 | SESSION_VERSION)) throw new Error("unsupported session version");
+    for(let i = 0; i < size * size; i++) {
+        // points are stored as color ^ 2, so empty is 0
+        state.push(((byte(SESSION_HEADER + (i >> 2)) >> ((i & 3) << 1)) & 3) ^ 2);
+    }
+    return { blackScore: word(4), whiteScore: word(6), state: state }
+}
+
 class Game {
     /**
      * Initialize game
@@ -163,15 +197,11 @@ class Game {
             const response = xhr.response;
             this.session = response.session;
             this.signature = response.signature;
-            const params = this.session.split(" ")
-            const blackScore = parseFloat(params[3]) / 10
-            const whiteScore = parseFloat(params[4]) / 10
+            const decoded = decodeSession(this.session)
+            const blackScore = decoded.blackScore / 10
+            const whiteScore = decoded.whiteScore / 10
             this.parent.querySelectorAll(".highlighted").forEach(a => a.className = a.className.replace("highlighted", ""))
-            this.state = params[5].split("").map(a => {
-                if(a == "+") return EMPTY;
-                else if(a == "X") return BLACK;
-                else return WHITE;
-            })
+            this.state = decoded.state
 
             document.getElementById("white_score").textContent = whiteScore.toFixed(1);
             document.getElementById("black_score").textContent = blackScore.toFixed(1);
@@ -209,6 +239,12 @@ class Game {
                 }
             }
 
+            if(response.score) {
+                const score = response.score
+                const winner = score.margin > 0 ? "Black" : "White"
+                alert(`Game over, ${winner} wins by ${Math.abs(score.margin).toFixed(1)} (area ${score.black} : ${score.white} + ${score.komi.toFixed(1)})`)
+            }
+
             return true;
         }
 
@@ -2,95 +2,116 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 #include "ai.h"
+#include "tt.h"
+#include "pool.h"
+#include "arena.h"
+#include "cache.h"
+#include "book.h"
+#include "stats.h"
+#include "ponder.h"
+#include "pattern.h"
+#include "score.h"
+#include "tactics.h"
 
-#define PASS_SPREAD 0.05
-#define PASS_SPREAD_BIG 0.3
+#define PASS_DAME_SHARE 16      // a count with more dame than square / PASS_DAME_SHARE isn't settled
+#define BEAM_TACTICS_SPREAD 2   // candidates read out per pick, the rest keep their static rating
 
 static double logs[4000];
 static double group_bonus[4000];
+static uint64_t zobrist[2][MAX_SQUARE];
+static uint64_t zobrist_ko[MAX_SQUARE];
+static uint64_t zobrist_turn;
+// index permutations of the 8 symmetries per board size, bit 2 transposes,
+// bit 0 mirrors x and bit 1 mirrors y, symmetry_back undoes them
+static short symmetry[MAX_BOARD + 1][8][MAX_SQUARE];
+static short symmetry_back[MAX_BOARD + 1][8][MAX_SQUARE];
 
-static void int_vec_init(INT_VEC *vec, int capacity, int *mem) {
-    vec->capacity = capacity;
-    vec->size = 0;
-    vec->refs = 0;
-    if(mem) {
-        vec->values = mem;
-        vec->on_stack = 1;
-    } else {
-        vec->values = allocate(NULL, capacity * sizeof(int));
-        vec->on_stack = 0;
-    }
-}
+// size specialized entry points, each board points at the set of its size
+typedef struct board_kernels {
+    int  (*place)(BOARD *board, UNDO_STACK *undo, int x, int y, CELL_COLOR color);
+    void (*move_info)(BOARD *board, CELL_COLOR color, int place, MOVE_INFO *info);
+    int  (*generate_moves)(BOARD *board, CELL_COLOR color, MOVE_INFO *out);
+    void (*group_propagate)(BOARD *board, LIBERTY_SET *liberties, int place, int group);
+    void (*pack_cells)(BOARD *board, unsigned char *out);
+    int  (*unpack_cells)(BOARD *board, const unsigned char *in);
+} BOARD_KERNELS;
 
-static void int_vec_add(INT_VEC *vec, int element) {
-    int *prev = vec->values;
-    if(vec->size >= vec->capacity) {
-        vec->capacity = (vec->capacity + 1000) * 2;
-        if(vec->on_stack) {
-            vec->values = allocate(NULL, vec->capacity * sizeof(int));
-            if(vec->values) {
-                vec->on_stack = 0;
-                memcpy(vec->values, prev, sizeof(int) * vec->size);
-            }
-        } else {
-            vec->values = allocate(vec->values, vec->capacity * sizeof(int));
+static const BOARD_KERNELS *board_kernels_for(int size);
+
+// neighbour i of a point sits at 7 - i in the neighbour's own pattern code
+static const int pattern_dx[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+static const int pattern_dy[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+
+static void board_patterns_rebuild(BOARD *board) {
+    int size = board->size, n, i, x, y;
+    unsigned code;
+    for(n = 0; n < board->square; n++) {
+        code = 0;
+        for(i = 0; i < 8; i++) {
+            x = n % size + pattern_dx[i];
+            y = n / size + pattern_dy[i];
+            if(x < 0 || y < 0 || x >= size || y >= size) code |= PATTERN_EDGE << (2 * i);
+            else code |= pattern_field(board->cells[y * size + x].color) << (2 * i);
         }
-    }
-    if(vec->values) {
-        vec->values[vec->size++] = element;
+        board->patterns[n] = code;
     }
 }
 
-static void int_vec_rel(INT_VEC *vec) {
-    if(vec->values) {
-        if(vec->on_stack == 0) {
-            allocate(vec->values, 0);
-        }
-        vec->capacity = 0;
-        vec->size = 0;
-        vec->values = NULL;
-    }
+static inline void liberty_set_clear(LIBERTY_SET *set) {
+    int i;
+    for(i = 0; i < LIBERTY_WORDS; i++) set->w[i] = 0;
 }
 
-static void int_vec_add_ref(INT_VEC *vec) {
-    vec->refs++;
+static inline void liberty_set_add(LIBERTY_SET *set, int place) {
+    set->w[place >> 6] |= 1ULL << (place & 63);
 }
 
-static void int_vec_dec_ref(INT_VEC *vec) {
-    vec->refs--;
+static inline int liberty_set_count(const LIBERTY_SET *set) {
+    int i, n = 0;
+    for(i = 0; i < LIBERTY_WORDS; i++) n += __builtin_popcountll(set->w[i]);
+    return n;
 }
 
 void board_init(BOARD* board, int size, int komi) {
-    int n, sq;
+    int n;
     if(size > MAX_BOARD) size = MAX_BOARD;
     if(size < 0) size = 0;
-    board->parent = NULL;
     board->size = size;
     board->square = size * size;
+    board->kernels = board_kernels_for(size);
     board->ko = -1;
     board->white_score = komi;
     board->black_score = 0;
     board->turn = BLACK;
+    board->hash = 0;
+    board->white = 0;
+    board->black = 0;
+    board->white_groups = 0;
+    board->black_groups = 0;
+    board->white_liberties = 0;
+    board->black_liberties = 0;
     for(n = 0; n < board->square; n++) {
         board->cells[n].color = EMPTY;
         board->cells[n].group = 0;
-        board->cells[n].liberties = NULL;
+        board->groups.head[n] = -1;
     }
+    board_patterns_rebuild(board);
 }
 
 void board_release(BOARD *board) {
 
 }
 
-static void board_copy(BOARD* out, BOARD* board) {
+void board_copy(BOARD* out, BOARD* board) {
     int n;
-    out->parent = board->parent;
-    out->best_child = board->best_child;
+    STAT_ADD(copies, 1);
     out->size = board->size;
     out->square = board->square;
-    out->id = board->id;
-    out->score = board->score;
+    out->kernels = board->kernels;
     out->white = board->white;
     out->black = board->black;
     out->white_score = board->white_score;
@@ -101,56 +122,80 @@ static void board_copy(BOARD* out, BOARD* board) {
     out->white_liberties = board->white_liberties;
     out->ko = board->ko;
     out->turn = board->turn;
+    out->hash = board->hash;
     for(n = 0; n < board->square; n++) {
         out->cells[n].color = board->cells[n].color;
         out->cells[n].n_liberties = board->cells[n].n_liberties;
         out->cells[n].group = board->cells[n].group;
-        out->cells[n].liberties = board->cells[n].liberties;
     }
+    memcpy(out->groups.head, board->groups.head, sizeof(short) * board->square);
+    memcpy(out->groups.next, board->groups.next, sizeof(short) * board->square);
+    memcpy(out->groups.stones, board->groups.stones, sizeof(short) * board->square);
+    memcpy(out->groups.liberties, board->groups.liberties, sizeof(short) * board->square);
+    memcpy(out->patterns, board->patterns, sizeof(short) * board->square);
 }
 
-static void board_add_liberty(BOARD *board, INT_VEC *liberties, int x, int y) {
-    if(x < 0 || y < 0 || x >= board->size || y >= board->size) return;
-    int place = y * board->size + x, n;
-    CELL *cell = &board->cells[place];
-    for(n = 0; n < liberties->size; n++) {
-        if(liberties->values[n] == place) return;
-    }
-    if(cell->color == EMPTY) {
-        int_vec_add(liberties, place);
+// the hot loops below take the board size N as a constant, they are
+// instantiated per common size by BOARD_KERNELS_FOR, N = 0 reads it from the board
+#define BOARD_KERNEL static inline __attribute__((always_inline))
+#define KERNEL_SIZE(board, N) ((N) ? (N) : (board)->size)
+
+BOARD_KERNEL int board_neighbours_n(BOARD *board, int place, int *out, const int N) {
+    int size = KERNEL_SIZE(board, N), x = place % size, n = 0;
+    if(x + 1 < size) out[n++] = place + 1;
+    if(x > 0) out[n++] = place - 1;
+    if(place + size < size * size) out[n++] = place + size;
+    if(place >= size) out[n++] = place - size;
+    return n;
+}
+
+static int board_neighbours(BOARD *board, int place, int *out) {
+    return board_neighbours_n(board, place, out, 0);
+}
+
+// a point changed color, only the codes of its 8 neighbours change
+BOARD_KERNEL void board_pattern_update_n(BOARD *board, int place, CELL_COLOR old, CELL_COLOR color, const int N) {
+    int size = KERNEL_SIZE(board, N), x = place % size, y = place / size, i, nx, ny;
+    unsigned delta = pattern_field(old) ^ pattern_field(color);
+    for(i = 0; i < 8; i++) {
+        nx = x + pattern_dx[i];
+        ny = y + pattern_dy[i];
+        if(nx < 0 || ny < 0 || nx >= size || ny >= size) continue;
+        board->patterns[ny * size + nx] ^= delta << (2 * (7 - i));
     }
 }
 
-static void board_group_propagate(BOARD* board, INT_VEC *liberties, int x, int y, CELL_COLOR color, int group) {
-    int stk[MAX_BOARD * MAX_BOARD + 5], sp = 0, size = board->size;
-    stk[sp] = y * size + x;
-    while(sp >= 0 && sp < board->square) {
-        y = stk[sp] / size;
-        x = stk[sp--] % size;
-        CELL *cell = &board->cells[y * size + x];
-        if(cell->color == color && cell->group == 0) {
-            cell->group = group;
-            cell->liberties = liberties;
-            int_vec_add_ref(liberties);
-            board_add_liberty(board, liberties, x + 1, y);
-            board_add_liberty(board, liberties, x - 1, y);
-            board_add_liberty(board, liberties, x, y - 1);
-            board_add_liberty(board, liberties, x, y + 1);
-            if(x + 1 < size) stk[++sp] = y * size + (x + 1);
-            if(x - 1 >= 0) stk[++sp] = y * size + (x - 1);
-            if(y + 1 < size) stk[++sp] = (y + 1) * size + x;
-            if(y - 1 >= 0) stk[++sp] = (y - 1) * size + x;
+// flood fills the group from place collecting its liberties, stones are
+// marked when pushed, so the stack never holds more than the board
+BOARD_KERNEL void board_group_propagate_n(BOARD* board, LIBERTY_SET *liberties, int place, int group, const int N) {
+    CELL_COLOR color = board->cells[place].color;
+    int stk[MAX_SQUARE], around[4], sp = 0, i, k;
+    CELL *cell;
+    liberty_set_clear(liberties);
+    board->cells[place].group = group;
+    stk[sp++] = place;
+    while(sp > 0) {
+        k = board_neighbours_n(board, stk[--sp], around, N);
+        for(i = 0; i < k; i++) {
+            cell = &board->cells[around[i]];
+            if(cell->color == EMPTY) {
+                liberty_set_add(liberties, around[i]);
+            } else if(cell->color == color && cell->group == 0) {
+                cell->group = group;
+                stk[sp++] = around[i];
+            }
         }
     }
 }
 
 int board_refresh(BOARD *board, int place_x, int place_y, CELL_COLOR color, int update) {
-    int x, y, n = 0, group = 1, suicide = 0, maybe_suicide = 0, place = place_y * board->size + place_x, id;
-    int to_remove[board->square], to_remove_n = 0, self_remove = 0;
-    int liberties_arr[MAX_BOARD * MAX_BOARD / 2][MAX_BOARD * MAX_BOARD];
-    INT_VEC liberties[MAX_BOARD * MAX_BOARD / 2];
+    int n, group = 1, place = place_y * board->size + place_x;
+    int to_remove[MAX_SQUARE], to_remove_n = 0, self_remove = 0;
+    short counts[MAX_SQUARE + 1];   // liberties by group id, 0 is no group
+    LIBERTY_SET liberties;
 
     CELL *cell;
+    STAT_ADD(refreshes, 1);
     // clean-up old state if there was any
     board->white_groups = 0;
     board->black_groups = 0;
@@ -161,49 +206,36 @@ int board_refresh(BOARD *board, int place_x, int place_y, CELL_COLOR color, int
     for(n = 0; n < board->square; n++) {
         cell = &board->cells[n];
         cell->group = 0;
-        cell->liberties = NULL;
         cell->n_liberties = 0;
         board->white += cell->color == WHITE;
         board->black += cell->color == BLACK;
     }
 
-    n = 0;
-
     // propagate state
-    for(y = 0; y < board->size; y++) {
-        for(x = 0; x < board->size; x++, n++) {
-            cell = &board->cells[n];
-            if(cell->group) {
-                continue;
-            } else if(cell->color != EMPTY) {
-                id = group++;
-                if(cell->color == BLACK) board->black_groups++;
-                else board->white_groups++;
-                int_vec_init(liberties + id, MAX_BOARD * MAX_BOARD, liberties_arr[id]);
-                board_group_propagate(board, liberties + id, x, y, cell->color, id);
-            } else {
-                cell->group = 0;
-                cell->liberties = NULL;
-            }
+    counts[0] = 0;
+    for(n = 0; n < board->square; n++) {
+        cell = &board->cells[n];
+        if(cell->group || cell->color == EMPTY) continue;
+        board->kernels->group_propagate(board, &liberties, n, group);
+        counts[group] = liberty_set_count(&liberties);
+        if(cell->color == BLACK) {
+            board->black_groups++;
+            board->black_liberties += counts[group];
+        } else {
+            board->white_groups++;
+            board->white_liberties += counts[group];
         }
+        group++;
     }
 
     // check our liberties
     for(n = 0; n < board->square; n++) {
         cell = &board->cells[n];
-        if(cell->liberties) {
-            cell->n_liberties = cell->liberties->size;
-            if(cell->liberties->size == 0) {
-                if(cell->color == color) self_remove++;
-                else to_remove[to_remove_n++] = n;
-            }
-            int_vec_dec_ref(cell->liberties);
-            if(cell->liberties->refs == 0) {
-                if(cell->color == BLACK) board->black_liberties += cell->liberties->size;
-                else if(cell->color == WHITE) board->white_liberties += cell->liberties->size;
-                int_vec_rel(cell->liberties);
-                cell->liberties = NULL;
-            }
+        if(!cell->group) continue;
+        cell->n_liberties = counts[cell->group];
+        if(cell->n_liberties == 0) {
+            if(cell->color == color) self_remove++;
+            else to_remove[to_remove_n++] = n;
         }
     }
 
@@ -235,136 +267,1083 @@ int board_refresh(BOARD *board, int place_x, int place_y, CELL_COLOR color, int
     }
 }
 
+static short *board_color_liberties(BOARD *board, CELL_COLOR color) {
+    return color == BLACK ? &board->black_liberties : &board->white_liberties;
+}
+
+static short *board_color_groups(BOARD *board, CELL_COLOR color) {
+    return color == BLACK ? &board->black_groups : &board->white_groups;
+}
+
+// group record and color writes go through these so make/unmake can roll them back
+static inline void board_write(UNDO_STACK *undo, short *addr, int value) {
+    UNDO_WRITE *write;
+    if(undo) {
+        write = undo->writes + undo->n_writes++;
+        write->addr = addr;
+        write->old = *addr;
+        write->is_color = 0;
+    }
+    *addr = value;
+}
+
+BOARD_KERNEL void board_write_color_n(BOARD *board, UNDO_STACK *undo, int place, CELL_COLOR color, const int N) {
+    CELL *cell = board->cells + place;
+    UNDO_WRITE *write;
+    if(undo) {
+        write = undo->writes + undo->n_writes++;
+        write->addr = &cell->color;
+        write->old = cell->color;
+        write->is_color = 1;
+    }
+    board_pattern_update_n(board, place, cell->color, color, N);
+    cell->color = color;
+}
+
+// count distinct empty points around the group, only walks the group itself
+BOARD_KERNEL int board_count_liberties_n(BOARD *board, int head, const int N) {
+    GROUP_STATE *groups = &board->groups;
+    LIBERTY_SET liberties;
+    int around[4], i, k, stone = head;
+    liberty_set_clear(&liberties);
+    do {
+        k = board_neighbours_n(board, stone, around, N);
+        for(i = 0; i < k; i++) {
+            if(board->cells[around[i]].color == EMPTY) liberty_set_add(&liberties, around[i]);
+        }
+        stone = groups->next[stone];
+    } while(stone != head);
+    return liberty_set_count(&liberties);
+}
+
+BOARD_KERNEL void board_update_liberties_n(BOARD *board, UNDO_STACK *undo, int head, const int N) {
+    short *total = board_color_liberties(board, board->cells[head].color);
+    int libs = board_count_liberties_n(board, head, N);
+    *total += libs - board->groups.liberties[head];
+    board_write(undo, board->groups.liberties + head, libs);
+}
+
+// merges group b into group a, returns head of the merged group
+static int board_merge_groups(BOARD *board, UNDO_STACK *undo, int a, int b) {
+    GROUP_STATE *groups = &board->groups;
+    int stone, tmp;
+    if(groups->stones[a] < groups->stones[b]) {
+        tmp = a; a = b; b = tmp;
+    }
+    stone = b;
+    do {
+        board_write(undo, groups->head + stone, a);
+        stone = groups->next[stone];
+    } while(stone != b);
+    tmp = groups->next[a];
+    board_write(undo, groups->next + a, groups->next[b]);
+    board_write(undo, groups->next + b, tmp);
+    board_write(undo, groups->stones + a, groups->stones[a] + groups->stones[b]);
+    *board_color_liberties(board, board->cells[a].color) -= groups->liberties[b];
+    (*board_color_groups(board, board->cells[a].color))--;
+    return a;
+}
+
+// removes captured group from the board, returns number of removed stones
+BOARD_KERNEL int board_remove_group_n(BOARD *board, UNDO_STACK *undo, int head, int *touched, int *n_touched, const int N) {
+    GROUP_STATE *groups = &board->groups;
+    CELL_COLOR color = board->cells[head].color;
+    int around[4], i, j, k, removed = 0, stone = head, next;
+    *board_color_liberties(board, color) -= groups->liberties[head];
+    (*board_color_groups(board, color))--;
+    do {
+        next = groups->next[stone];
+        board->hash ^= zobrist[color][stone];
+        board_write_color_n(board, undo, stone, EMPTY, N);
+        board_write(undo, groups->head + stone, -1);
+        removed++;
+        stone = next;
+    } while(stone != head);
+    // remember groups which gained liberties by the removal
+    do {
+        k = board_neighbours_n(board, stone, around, N);
+        for(i = 0; i < k; i++) {
+            if(board->cells[around[i]].color == EMPTY) continue;
+            for(j = 0; j < *n_touched && touched[j] != groups->head[around[i]]; j++);
+            if(j == *n_touched) touched[(*n_touched)++] = groups->head[around[i]];
+        }
+        stone = groups->next[stone];
+    } while(stone != head);
+    if(color == WHITE) {
+        board->white -= removed;
+        board->black_score += 10 * removed;
+    } else {
+        board->black -= removed;
+        board->white_score += 10 * removed;
+    }
+    return removed;
+}
+
+BOARD_KERNEL int board_place_n(BOARD* board, UNDO_STACK *undo, int x, int y, CELL_COLOR color, const int N) {
+    const int size = KERNEL_SIZE(board, N);
+    if(x < 0 || y < 0 || x >= size || y >= size) return ERR_OOB;
+    if(y * size + x == board->ko) return ERR_KO;
+    GROUP_STATE *groups = &board->groups;
+    int place = y * size + x, around[4], heads[4], touched[MAX_SQUARE];
+    int i, j, k, n_heads = 0, n_touched = 0, captured = 0, removed = 0, escape = 0, head, last = -1;
+    CELL *cell = &board->cells[place];
+    if(cell->color != EMPTY) return ERR_PLACED;
+
+    // distinct neighbouring groups decide captures and suicide before anything is written
+    k = board_neighbours_n(board, place, around, N);
+    for(i = 0; i < k; i++) {
+        head = groups->head[around[i]];
+        if(head < 0) {
+            escape = 1;
+            continue;
+        }
+        for(j = 0; j < n_heads && heads[j] != head; j++);
+        if(j < n_heads) continue;
+        heads[n_heads++] = head;
+        if(board->cells[head].color != color && groups->liberties[head] == 1) captured++;
+        else if(board->cells[head].color == color && groups->liberties[head] > 1) escape = 1;
+    }
+    if(!captured && !escape) return ERR_SUICIDE;
+
+    board_write_color_n(board, undo, place, color, N);
+    board->hash ^= zobrist[color][place];
+    board_write(undo, groups->head + place, place);
+    board_write(undo, groups->next + place, place);
+    board_write(undo, groups->stones + place, 1);
+    board_write(undo, groups->liberties + place, 0);
+    (*board_color_groups(board, color))++;
+    if(color == BLACK) board->black++;
+    else board->white++;
+
+    head = place;
+    for(i = 0; i < n_heads; i++) {
+        if(board->cells[heads[i]].color == color) {
+            head = board_merge_groups(board, undo, head, heads[i]);
+        } else if(groups->liberties[heads[i]] == 1) {
+            removed += board_remove_group_n(board, undo, heads[i], touched, &n_touched, N);
+            last = heads[i];
+        } else {
+            board_write(undo, groups->liberties + heads[i], groups->liberties[heads[i]] - 1);
+            (*board_color_liberties(board, board->cells[heads[i]].color))--;
+        }
+    }
+
+    board_update_liberties_n(board, undo, head, N);
+    for(i = 0; i < n_touched; i++) {
+        if(groups->head[touched[i]] != touched[i]) touched[i] = groups->head[touched[i]];
+        if(touched[i] != head) board_update_liberties_n(board, undo, touched[i], N);
+    }
+    board_set_ko(board, removed == 1 ? last : -1);
+    return removed;
+}
+
+static int board_place_logged(BOARD* board, UNDO_STACK *undo, int x, int y, CELL_COLOR color) {
+    int ok = board->kernels->place(board, undo, x, y, color);
+    STAT_ADD(places, 1);
+    if(ok < 0 && ok > -STATS_ERRORS) STAT_ADD(place_errors[-ok], 1);
+    return ok;
+}
+
 int board_place(BOARD* board, int x, int y, CELL_COLOR color) {
+    return board_place_logged(board, NULL, x, y, color);
+}
+
+void board_undo_init(UNDO_STACK *undo) {
+    undo->n_frames = 0;
+    undo->n_writes = 0;
+}
+
+// plays the move and hands the turn over, x = y = -1 passes; nothing is recorded on error
+int board_make_move(BOARD *board, UNDO_STACK *undo, int x, int y, CELL_COLOR color) {
+    UNDO_FRAME *frame;
+    int ok;
+    if(undo->n_frames >= MAX_UNDO_DEPTH || undo->n_writes + MAX_MOVE_WRITES(board->square) > MAX_UNDO_WRITES) return ERR_DEPTH;
+    frame = undo->frames + undo->n_frames;
+    frame->hash = board->hash;
+    frame->writes = undo->n_writes;
+    frame->ko = board->ko;
+    frame->white_score = board->white_score;
+    frame->black_score = board->black_score;
+    frame->white_liberties = board->white_liberties;
+    frame->black_liberties = board->black_liberties;
+    frame->white_groups = board->white_groups;
+    frame->black_groups = board->black_groups;
+    frame->white = board->white;
+    frame->black = board->black;
+    frame->turn = board->turn;
+    if(x == -1 && y == -1) {
+        board_set_ko(board, -1);
+        ok = 0;
+    } else {
+        ok = board_place_logged(board, undo, x, y, color);
+        if(ok < 0) return ok;
+    }
+    board_set_turn(board, color == BLACK ? WHITE : BLACK);
+    undo->n_frames++;
+    return ok;
+}
+
+void board_unmake_move(BOARD *board, UNDO_STACK *undo) {
+    UNDO_FRAME *frame;
+    UNDO_WRITE *write;
+    CELL *cell;
+    if(undo->n_frames == 0) return;
+    frame = undo->frames + --undo->n_frames;
+    while(undo->n_writes > frame->writes) {
+        write = undo->writes + --undo->n_writes;
+        if(write->is_color) {
+            cell = (CELL*)write->addr;
+            board_pattern_update_n(board, cell - board->cells, cell->color, (CELL_COLOR)write->old, 0);
+            cell->color = (CELL_COLOR)write->old;
+        } else {
+            *(short*)write->addr = (short)write->old;
+        }
+    }
+    board->hash = frame->hash;
+    board->ko = frame->ko;
+    board->white_score = frame->white_score;
+    board->black_score = frame->black_score;
+    board->white_liberties = frame->white_liberties;
+    board->black_liberties = frame->black_liberties;
+    board->white_groups = frame->white_groups;
+    board->black_groups = frame->black_groups;
+    board->white = frame->white;
+    board->black = frame->black;
+    board->turn = frame->turn;
+}
+
+void board_set_ko(BOARD *board, int ko) {
+    if(board->ko >= 0) board->hash ^= zobrist_ko[board->ko];
+    if(ko >= 0) board->hash ^= zobrist_ko[ko];
+    board->ko = ko;
+}
+
+void board_set_turn(BOARD *board, CELL_COLOR turn) {
+    if(turn != board->turn) board->hash ^= zobrist_turn;
+    board->turn = turn;
+}
+
+// hash extended by the board size and the scores, two positions with same key
+// rate the same, the size keeps boards of different sizes apart
+static uint64_t position_key(uint64_t hash, int size, short black_score, short white_score) {
+    uint64_t z = hash + ((uint64_t)size << 32 | (uint64_t)(unsigned short)black_score << 16 | (unsigned short)white_score) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    return z ^ (z >> 27);
+}
+
+uint64_t board_key(BOARD *board) {
+    return position_key(board->hash, board->size, board->black_score, board->white_score);
+}
+
+// key of the orientation with the smallest key among the 8 symmetries and the
+// symmetry that maps the board onto it, all symmetric positions share the key
+int board_canonical(BOARD *board, uint64_t *key) {
+    uint64_t stones[8] = {0}, rest, hash, best_key = 0;
+    int n, t, best = 0;
+    CELL_COLOR color;
+    for(n = 0; n < board->square; n++) {
+        color = board->cells[n].color;
+        if(color == EMPTY) continue;
+        for(t = 0; t < 8; t++) stones[t] ^= zobrist[color][symmetry[(int)board->size][t][n]];
+    }
+    // turn and ko terms of the hash stay, the ko point moves with the board
+    rest = board->hash ^ stones[0];
+    if(board->ko >= 0) rest ^= zobrist_ko[board->ko];
+    for(t = 0; t < 8; t++) {
+        hash = rest ^ stones[t];
+        if(board->ko >= 0) hash ^= zobrist_ko[symmetry[(int)board->size][t][board->ko]];
+        hash = position_key(hash, board->size, board->black_score, board->white_score);
+        if(t == 0 || hash < best_key) {
+            best_key = hash;
+            best = t;
+        }
+    }
+    *key = best_key;
+    return best;
+}
+
+int board_to_canonical(BOARD *board, int symmetry_index, int place) {
+    if(place < 0 || place >= board->square) return place;
+    return symmetry[(int)board->size][symmetry_index][place];
+}
+
+int board_from_canonical(BOARD *board, int symmetry_index, int place) {
+    if(place < 0 || place >= board->square) return place;
+    return symmetry_back[(int)board->size][symmetry_index][place];
+}
+
+void board_transform(BOARD *out, BOARD *board, int symmetry_index) {
+    int n;
+    board_copy(out, board);
+    for(n = 0; n < board->square; n++) {
+        out->cells[symmetry[(int)board->size][symmetry_index][n]].color = board->cells[n].color;
+    }
+    out->ko = board_to_canonical(board, symmetry_index, board->ko);
+    board_rebuild(out);
+}
+
+BOARD_KERNEL void board_move_info_n(BOARD *board, CELL_COLOR color, int place, MOVE_INFO *info, const int N) {
+    const int size = KERNEL_SIZE(board, N);
+    GROUP_STATE *groups = &board->groups;
+    unsigned char seen[MAX_SQUARE];
+    int around[4], lib_around[4], heads[4], i, j, k, l, n_heads = 0, head, stone, escape = 0, libs = 0, merged = 0, joined = 0;
+    CELL_COLOR other = color == BLACK ? WHITE : BLACK;
+    memset(info, 0, sizeof(MOVE_INFO));
+    info->place = place;
+    info->exact = 1;
+    if(board->cells[place].color != EMPTY) {
+        info->err = ERR_PLACED;
+        return;
+    }
+    if(place == board->ko) {
+        info->err = ERR_KO;
+        return;
+    }
+    k = board_neighbours_n(board, place, around, N);
+    for(i = 0; i < k; i++) {
+        head = groups->head[around[i]];
+        if(head < 0) {
+            escape = 1;
+            continue;
+        }
+        for(j = 0; j < n_heads && heads[j] != head; j++);
+        if(j < n_heads) continue;
+        heads[n_heads++] = head;
+        if(board->cells[head].color == color) {
+            if(groups->liberties[head] > 1) escape = 1;
+            info->d_my_groups--;
+            info->d_my_liberties -= groups->liberties[head];
+            joined += groups->stones[head];
+            merged = 1;
+        } else if(groups->liberties[head] == 1) {
+            info->captured += groups->stones[head];
+            info->d_op_groups--;
+            info->d_op_liberties--;
+        } else {
+            info->d_op_liberties--;
+        }
+    }
+    if(!info->captured && !escape) {
+        info->err = ERR_SUICIDE;
+        return;
+    }
+    // one table lookup, the code is kept up to date by every color change
+    info->prior = pattern_weights[pattern_code(board->patterns[place], color)];
+    if(info->prior == PATTERN_PRUNE) {
+        info->pruned = 1;
+        info->prior = 0.0f;
+    }
+    info->d_my_stones = 1;
+    info->d_my_groups++;
+    info->d_my_score = 10 * info->captured;
+    info->d_op_stones = -info->captured;
+    if(info->captured) {
+        info->exact = 0;
+        return;
+    }
+
+    // liberties of the merged group: union of the friendly groups' liberties and own empty neighbours
+    if(merged) memset(seen, 0, size * size);
+    seen[place] = 1;
+    for(i = 0; i < k; i++) {
+        if(board->cells[around[i]].color == EMPTY && (!merged || !seen[around[i]])) {
+            if(merged) seen[around[i]] = 1;
+            libs++;
+        }
+    }
+    for(i = 0; i < n_heads; i++) {
+        if(board->cells[heads[i]].color != color) continue;
+        stone = heads[i];
+        do {
+            l = board_neighbours_n(board, stone, lib_around, N);
+            for(j = 0; j < l; j++) {
+                if(board->cells[lib_around[j]].color == EMPTY && !seen[lib_around[j]]) {
+                    seen[lib_around[j]] = 1;
+                    libs++;
+                }
+            }
+            stone = groups->next[stone];
+        } while(stone != heads[i]);
+    }
+    info->d_my_liberties += libs;
+    if(libs == 1) info->self_atari = 1 + joined;
+
+    // a quiet move clears ko and hands the turn to the opponent
+    info->key = board->hash ^ zobrist[color][place];
+    if(board->ko >= 0) info->key ^= zobrist_ko[board->ko];
+    if(board->turn != other) info->key ^= zobrist_turn;
+    info->key = position_key(info->key, size, board->black_score, board->white_score);
+}
+
+// one record per empty point, returns number of records
+BOARD_KERNEL int board_generate_moves_n(BOARD *board, CELL_COLOR color, MOVE_INFO *out, const int N) {
+    const int square = KERNEL_SIZE(board, N) * KERNEL_SIZE(board, N);
+    int p, n = 0;
+    for(p = 0; p < square; p++) {
+        if(board->cells[p].color != EMPTY) continue;
+        board_move_info_n(board, color, p, out + n, N);
+        if(out[n].err < 0) STAT_ADD(candidate_errors[-out[n].err], 1);
+        n++;
+    }
+    STAT_ADD(candidates, n);
+    return n;
+}
+
+// points are stored as color ^ 2 so that empty is 0 and 1 is never valid
+BOARD_KERNEL void board_pack_cells_n(BOARD *board, unsigned char *out, const int N) {
+    const int square = KERNEL_SIZE(board, N) * KERNEL_SIZE(board, N);
+    int i;
+    memset(out, 0, (square + 3) / 4);
+    for(i = 0; i < square; i++) {
+        out[i >> 2] |= (board->cells[i].color ^ 2) << ((i & 3) << 1);
+    }
+}
+
+// returns -1 if a point holds the unused code
+BOARD_KERNEL int board_unpack_cells_n(BOARD *board, const unsigned char *in, const int N) {
+    const int square = KERNEL_SIZE(board, N) * KERNEL_SIZE(board, N);
+    int i, code, invalid = 0;
+    for(i = 0; i < square; i++) {
+        code = (in[i >> 2] >> ((i & 3) << 1)) & 3;
+        invalid |= code == 1;
+        board->cells[i].color = (CELL_COLOR)(code ^ 2);
+    }
+    return invalid ? -1 : 0;
+}
+
+
+#define BOARD_KERNELS_FOR(N) \
+    static int board_place_##N(BOARD *board, UNDO_STACK *undo, int x, int y, CELL_COLOR color) { \
+        return board_place_n(board, undo, x, y, color, N); \
+    } \
+    static void board_move_info_##N(BOARD *board, CELL_COLOR color, int place, MOVE_INFO *info) { \
+        board_move_info_n(board, color, place, info, N); \
+    } \
+    static int board_generate_moves_##N(BOARD *board, CELL_COLOR color, MOVE_INFO *out) { \
+        return board_generate_moves_n(board, color, out, N); \
+    } \
+    static void board_group_propagate_##N(BOARD *board, LIBERTY_SET *liberties, int place, int group) { \
+        board_group_propagate_n(board, liberties, place, group, N); \
+    } \
+    static void board_pack_cells_##N(BOARD *board, unsigned char *out) { \
+        board_pack_cells_n(board, out, N); \
+    } \
+    static int board_unpack_cells_##N(BOARD *board, const unsigned char *in) { \
+        return board_unpack_cells_n(board, in, N); \
+    } \
+    static const BOARD_KERNELS board_kernels_##N = { \
+        board_place_##N, board_move_info_##N, board_generate_moves_##N, \
+        board_group_propagate_##N, board_pack_cells_##N, board_unpack_cells_##N \
+    };
+
+BOARD_KERNELS_FOR(0)
+BOARD_KERNELS_FOR(9)
+BOARD_KERNELS_FOR(13)
+BOARD_KERNELS_FOR(19)
+
+static const BOARD_KERNELS *board_kernels_for(int size) {
+    switch(size) {
+        case 9: return &board_kernels_9;
+        case 13: return &board_kernels_13;
+        case 19: return &board_kernels_19;
+        default: return &board_kernels_0;
+    }
+}
+
+void board_move_info(BOARD *board, CELL_COLOR color, int place, MOVE_INFO *info) {
+    board->kernels->move_info(board, color, place, info);
+}
+
+int board_generate_moves(BOARD *board, CELL_COLOR color, MOVE_INFO *out) {
+    return board->kernels->generate_moves(board, color, out);
+}
+
+// slow path: re-derives everything from colors via board_refresh and resyncs group records
+int board_place_reference(BOARD* board, int x, int y, CELL_COLOR color) {
+    int ok;
     if(x < 0 || y < 0 || x >= board->size || y >= board->size) return ERR_OOB;
     if(y * board->size + x == board->ko) return ERR_KO;
     CELL *cell = &board->cells[y * board->size + x];
     if(cell->color != EMPTY) return ERR_PLACED;
     board->cells[y * board->size + x].color = color;
-    return board_refresh(board, x, y, color, 1);
+    ok = board_refresh(board, x, y, color, 1);
+    if(ok >= 0) board_rebuild(board);
+    return ok;
+}
+
+void board_rebuild(BOARD *board) {
+    GROUP_STATE *groups = &board->groups;
+    int stk[MAX_SQUARE], around[4], sp, i, k, n, stone, prev;
+    CELL_COLOR color;
+    board->white = board->black = 0;
+    board->white_groups = board->black_groups = 0;
+    board->white_liberties = board->black_liberties = 0;
+    board->hash = board->turn == WHITE ? zobrist_turn : 0;
+    if(board->ko >= 0 && board->ko < board->square) board->hash ^= zobrist_ko[board->ko];
+    for(n = 0; n < board->square; n++) groups->head[n] = -1;
+    board_patterns_rebuild(board);
+    for(n = 0; n < board->square; n++) {
+        color = board->cells[n].color;
+        if(color != EMPTY) board->hash ^= zobrist[color][n];
+        if(color == EMPTY || groups->head[n] >= 0) continue;
+        groups->head[n] = n;
+        groups->stones[n] = 0;
+        groups->liberties[n] = 0;
+        prev = n;
+        sp = 0;
+        stk[sp++] = n;
+        while(sp > 0) {
+            stone = stk[--sp];
+            groups->next[prev] = stone;
+            groups->stones[n]++;
+            prev = stone;
+            k = board_neighbours(board, stone, around);
+            for(i = 0; i < k; i++) {
+                if(board->cells[around[i]].color == color && groups->head[around[i]] < 0) {
+                    groups->head[around[i]] = n;
+                    stk[sp++] = around[i];
+                }
+            }
+        }
+        groups->next[prev] = n;
+        (*board_color_groups(board, color))++;
+        if(color == BLACK) board->black += groups->stones[n];
+        else board->white += groups->stones[n];
+        board_update_liberties_n(board, NULL, n, 0);
+    }
+}
+
+// cross-checks incremental group records against the board_refresh reference
+// and the pattern codes against a rebuild, 0 if consistent
+int board_verify(BOARD *board) {
+    BOARD *ref = (BOARD*)allocate(NULL, sizeof(BOARD));
+    short seen[MAX_SQUARE];
+    int n, head, ok = 0;
+    if(!ref) return 0;
+    board_copy(ref, board);
+    board_patterns_rebuild(ref);
+    if(memcmp(ref->patterns, board->patterns, sizeof(short) * board->square)) ok = -1;
+    board_refresh(ref, -1, -1, EMPTY, 0);
+    if(ref->white != board->white || ref->black != board->black
+    || ref->white_groups != board->white_groups || ref->black_groups != board->black_groups
+    || ref->white_liberties != board->white_liberties || ref->black_liberties != board->black_liberties) {
+        ok = -1;
+    }
+    for(n = 0; n < board->square; n++) seen[n] = -1;
+    for(n = 0; n < board->square && ok == 0; n++) {
+        head = board->groups.head[n];
+        if((head < 0) != (board->cells[n].color == EMPTY)) ok = -1;
+        else if(head < 0) continue;
+        else if(board->cells[head].color != board->cells[n].color) ok = -1;
+        else if(board->groups.liberties[head] != ref->cells[n].n_liberties) ok = -1;
+        else if(seen[head] < 0) seen[head] = ref->cells[n].group;
+        else if(seen[head] != ref->cells[n].group) ok = -1;
+    }
+    allocate(ref, 0);
+    return ok;
 }
 
 static double uniform(double w) {
     return w / 2.0; // no random, * (double)rand() / RAND_MAX;
 }
 
-static double make_rating(BOARD *clone, CELL_COLOR color) {
-    double my_lib, my_area, my_score, op_lib, op_area, op_score, rating;
-    int my_groups, op_groups;
-    my_lib = color == BLACK ? clone->black_liberties : clone->white_liberties;
-    my_area = color == BLACK ? clone->black : clone->white;
-    my_score = color == BLACK ? clone->black_score : clone->white_score;
-    my_groups = color == BLACK ? clone->black_groups : clone->white_groups;
-
-    op_lib = color != BLACK ? clone->black_liberties : clone->white_liberties;
-    op_area = color != BLACK ? clone->black : clone->white;
-    op_score = color != BLACK ? clone->black_score : clone->white_score;
-    op_groups = color != BLACK ? clone->black_groups : clone->white_groups;
+// evaluation features from the point of view of the rated color
+typedef struct rating_features {
+    double my_lib;
+    double my_area;
+    double my_score;
+    int my_groups;
+    double op_lib;
+    double op_area;
+    double op_score;
+    int op_groups;
+} RATING_FEATURES;
 
+static void rating_features(BOARD *clone, CELL_COLOR color, RATING_FEATURES *f) {
+    f->my_lib = color == BLACK ? clone->black_liberties : clone->white_liberties;
+    f->my_area = color == BLACK ? clone->black : clone->white;
+    f->my_score = color == BLACK ? clone->black_score : clone->white_score;
+    f->my_groups = color == BLACK ? clone->black_groups : clone->white_groups;
+
+    f->op_lib = color != BLACK ? clone->black_liberties : clone->white_liberties;
+    f->op_area = color != BLACK ? clone->black : clone->white;
+    f->op_score = color != BLACK ? clone->black_score : clone->white_score;
+    f->op_groups = color != BLACK ? clone->black_groups : clone->white_groups;
+}
+
+static RATING_WEIGHTS weights = { 6000.0, -4000.0, 300.0, -300.0, -25.0, 25.0 };
+
+static inline double rate_one(double my_score, double op_score, double my_lib, double my_log,
+                              double op_lib, double op_log, double my_area, double op_area, double bonus) {
+    return weights.score * my_score
+        + weights.op_score * op_score
+        + weights.liberties * (my_lib / my_log)
+        + weights.op_liberties * (op_lib / op_log)
+        + weights.area * my_area
+        + weights.op_area * op_area
+        + bonus;
+}
+
+static double rate_features(RATING_FEATURES *f) {
+    int my_groups = f->my_groups, op_groups = f->op_groups;
     if(my_groups <= 1) my_groups = 1;
     if(op_groups <= 1) op_groups = 1;
-    
-    rating = 
-         6000   * my_score
-        -4000   * op_score
-        + 300  * (my_lib / logs[my_groups + 1])
-        - 300  * (op_lib / logs[op_groups + 1])
-        - 25  * my_area
-        + 25  * op_area
-        + group_bonus[my_groups]
-        - group_bonus[op_groups];
+    return rate_one(f->my_score, f->op_score, f->my_lib, logs[my_groups + 1], f->op_lib, logs[op_groups + 1],
+        f->my_area, f->op_area, group_bonus[my_groups] - group_bonus[op_groups]);
+}
+
+static double make_rating(BOARD *clone, CELL_COLOR color) {
+    RATING_FEATURES f;
+    rating_features(clone, color, &f);
+    return rate_features(&f);
+}
+
+static void move_features(BOARD *board, CELL_COLOR color, MOVE_INFO *info, RATING_FEATURES *f) {
+    rating_features(board, color, f);
+    f->my_lib += info->d_my_liberties;
+    f->my_area += info->d_my_stones;
+    f->my_score += info->d_my_score;
+    f->my_groups += info->d_my_groups;
+    f->op_lib += info->d_op_liberties;
+    f->op_area += info->d_op_stones;
+    f->op_groups += info->d_op_groups;
+}
+
+double board_rate(BOARD *board, CELL_COLOR color) {
+    STAT_ADD(ratings, 1);
+    return make_rating(board, color);
+}
+
+// make_rating of the position after an exact move, without playing it
+double board_rate_move(BOARD *board, CELL_COLOR color, MOVE_INFO *info) {
+    RATING_FEATURES f;
+    STAT_ADD(ratings, 1);
+    move_features(board, color, info, &f);
+    return rate_features(&f);
+}
+
+// a quiet self-atari counts its stones as captured, so it is searched last but
+// still searched, it may be a throw-in or a snapback the capture reader sees
+static double rate_self_atari(MOVE_INFO *info) {
+    return 10.0 * weights.op_score * info->self_atari;
+}
+
+// rating of the child from the mover's point of view, exact moves are rated
+// from their deltas, captures have to be played, -1e300 for an illegal move;
+// self-ataris are rated as lost
+double board_rate_child(BOARD *board, UNDO_STACK *undo, CELL_COLOR color, MOVE_INFO *info) {
+    double rating;
+    if(info->exact) return board_rate_move(board, color, info) + rate_self_atari(info);
+    if(board_make_move(board, undo, info->place % board->size, info->place / board->size, color) < 0) return -1e300;
+    rating = board_rate(board, color);
+    board_unmake_move(board, undo);
     return rating;
 }
 
-static int rating_sort(const void *a, const void *b) {
-    const BOARD *A = (const BOARD*)a;
-    const BOARD *B = (const BOARD*)b;
-    return B->score - A->score;
+// correction of the rating for color, who just moved at place, by the stones
+// the capture reader sees changing hands, valued like captured stones
+static double rate_tactics(BOARD *board, UNDO_STACK *undo, TACTICS_CACHE *cache, CELL_COLOR color, int place) {
+    int my_lost, op_lost;
+    tactics_balance(board, undo, cache, color, place, &my_lost, &op_lost);
+    return 10.0 * (weights.score * op_lost + weights.op_score * my_lost);
+}
+
+// children of one node in structure-of-arrays form, table lookups are resolved
+// when a row is added so scoring is a straight pass over the columns
+#define RATING_BATCH_MAX ((MAX_SQUARE + 3) & ~3)
+
+typedef struct rating_batch {
+    int n;
+    short slot[RATING_BATCH_MAX];   // candidate the row belongs to
+    double my_score[RATING_BATCH_MAX];
+    double op_score[RATING_BATCH_MAX];
+    double my_lib[RATING_BATCH_MAX];
+    double my_log[RATING_BATCH_MAX];
+    double op_lib[RATING_BATCH_MAX];
+    double op_log[RATING_BATCH_MAX];
+    double my_area[RATING_BATCH_MAX];
+    double op_area[RATING_BATCH_MAX];
+    double bonus[RATING_BATCH_MAX];
+    double score[RATING_BATCH_MAX];
+} RATING_BATCH;
+
+static void rating_batch_add(RATING_BATCH *batch, RATING_FEATURES *f, int slot) {
+    int i = batch->n++, my_groups = f->my_groups, op_groups = f->op_groups;
+    if(my_groups <= 1) my_groups = 1;
+    if(op_groups <= 1) op_groups = 1;
+    batch->slot[i] = slot;
+    batch->my_score[i] = f->my_score;
+    batch->op_score[i] = f->op_score;
+    batch->my_lib[i] = f->my_lib;
+    batch->my_log[i] = logs[my_groups + 1];
+    batch->op_lib[i] = f->op_lib;
+    batch->op_log[i] = logs[op_groups + 1];
+    batch->my_area[i] = f->my_area;
+    batch->op_area[i] = f->op_area;
+    batch->bonus[i] = group_bonus[my_groups] - group_bonus[op_groups];
+}
+
+static void rating_batch_score(RATING_BATCH *batch) {
+    int i = 0;
+    STAT_ADD(ratings, batch->n);
+#ifdef __AVX2__
+    __m256d w_score = _mm256_set1_pd(weights.score), w_op_score = _mm256_set1_pd(weights.op_score);
+    __m256d w_lib = _mm256_set1_pd(weights.liberties), w_op_lib = _mm256_set1_pd(weights.op_liberties);
+    __m256d w_area = _mm256_set1_pd(weights.area), w_op_area = _mm256_set1_pd(weights.op_area);
+    __m256d acc;
+    // same operation order as rate_one
+    for(; i + 4 <= batch->n; i += 4) {
+        acc = _mm256_mul_pd(w_score, _mm256_loadu_pd(batch->my_score + i));
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(w_op_score, _mm256_loadu_pd(batch->op_score + i)));
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(w_lib, _mm256_div_pd(_mm256_loadu_pd(batch->my_lib + i), _mm256_loadu_pd(batch->my_log + i))));
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(w_op_lib, _mm256_div_pd(_mm256_loadu_pd(batch->op_lib + i), _mm256_loadu_pd(batch->op_log + i))));
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(w_area, _mm256_loadu_pd(batch->my_area + i)));
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(w_op_area, _mm256_loadu_pd(batch->op_area + i)));
+        acc = _mm256_add_pd(acc, _mm256_loadu_pd(batch->bonus + i));
+        _mm256_storeu_pd(batch->score + i, acc);
+    }
+#endif
+    for(; i < batch->n; i++) {
+        batch->score[i] = rate_one(batch->my_score[i], batch->op_score[i], batch->my_lib[i], batch->my_log[i],
+            batch->op_lib[i], batch->op_log[i], batch->my_area[i], batch->op_area[i], batch->bonus[i]);
+    }
+}
+
+void ai_set_weights(RATING_WEIGHTS *w) {
+    weights = *w;
+}
+
+// identifies the evaluation the searches run with, EVAL_VERSION and the weights
+uint64_t ai_eval_fingerprint() {
+    const unsigned char *p = (const unsigned char*)&weights;
+    uint64_t hash = (0xCBF29CE484222325ULL ^ EVAL_VERSION) ^ pattern_fingerprint();
+    size_t i;
+    for(i = 0; i < sizeof(weights); i++) {
+        hash ^= p[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// text file of "name value" lines, names not listed keep their current weight
+int ai_load_weights(const char *path) {
+    RATING_WEIGHTS w = weights;
+    char line[256], name[64];
+    double value;
+    FILE *f = fopen(path, "r");
+    if(!f) return -1;
+    while(fgets(line, sizeof(line), f)) {
+        if(line[0] == '#' || sscanf(line, "%63s %lf", name, &value) != 2) continue;
+        if(!strcmp(name, "score")) w.score = value;
+        else if(!strcmp(name, "op_score")) w.op_score = value;
+        else if(!strcmp(name, "liberties")) w.liberties = value;
+        else if(!strcmp(name, "op_liberties")) w.op_liberties = value;
+        else if(!strcmp(name, "area")) w.area = value;
+        else if(!strcmp(name, "op_area")) w.op_area = value;
+        else {
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    weights = w;
+    return 0;
+}
+
+// partial selection: moves the best r candidates to the front, best first
+static void candidate_top(SEARCH_CANDIDATE *candidates, int n, int r) {
+    SEARCH_CANDIDATE tmp;
+    int i, j, best;
+    for(i = 0; i < r; i++) {
+        best = i;
+        for(j = i + 1; j < n; j++) {
+            if(candidates[j].score > candidates[best].score) best = j;
+        }
+        tmp = candidates[i];
+        candidates[i] = candidates[best];
+        candidates[best] = tmp;
+    }
 }
 
 static double rnd() {
     return ((double)rand()) / RAND_MAX;
 }
 
+// nodes only keep the move leading to them, positions are rebuilt by replaying
+// the path from the root, which is at most a handful of board_place calls
+static void search_replay(BOARD *out, BOARD *root, SEARCH_NODE *nodes, int index, CELL_COLOR color) {
+    short path[64];
+    int n = 0;
+    board_copy(out, root);
+    while(nodes[index].parent >= 0 && n < 64) {
+        path[n++] = nodes[index].move;
+        index = nodes[index].parent;
+    }
+    while(n-- > 0) {
+        board_place(out, path[n] % out->size, path[n] / out->size, color);
+        color = color == BLACK ? WHITE : BLACK;
+    }
+    board_set_turn(out, color);
+}
+
+// one depth level of the beam, pivots of the sector are expanded in parallel
+// and each writes its picks into its own fixed slots past sector_end
+typedef struct beam_level {
+    BOARD *root;
+    SEARCH_NODE *nodes;
+    BOARD *positions;               // scratch board per worker
+    UNDO_STACK *undo;               // undo stack per worker
+    SEARCH_CANDIDATE *candidates;   // board->square records per worker
+    MOVE_INFO *moves;               // board->square records per worker
+    RATING_BATCH *batches;          // one per worker
+    TACTICS_CACHE *tactics;         // one per worker, kept for the whole search
+    uint64_t *seen;                 // open addressed keys of one ply, seen_mask + 1 slots
+    int seen_mask;
+    CELL_COLOR root_color;
+    CELL_COLOR color;
+    int sector_start;
+    int children;       // first child slot of the sector
+    int pick_rate;
+    int ply;
+    int generation;
+    int exhausted;
+    int timed_out;
+    double deadline;    // 0 for no limit, the first ply always completes
+    int *abort;
+    TT_STATS tt[POOL_MAX_THREADS];
+    uint64_t nodes_rated[POOL_MAX_THREADS];
+} BEAM_LEVEL;
+
+static void beam_expand(void *ctx, int index, int worker) {
+    BEAM_LEVEL *level = (BEAM_LEVEL*)ctx;
+    int pivot = level->sector_start + index, i, m, n = 0, r, t;
+    BOARD *position = level->positions + worker;
+    UNDO_STACK *undo = level->undo + worker;
+    SEARCH_CANDIDATE *candidates = level->candidates + worker * level->root->square;
+    MOVE_INFO *moves = level->moves + worker * level->root->square, *move;
+    RATING_BATCH *batch = level->batches + worker;
+    RATING_FEATURES features;
+    SEARCH_NODE *out = level->nodes + level->children + index * level->pick_rate;
+    TT_STATS *tt = level->tt + worker;
+    TT_DATA cached;
+    CELL_COLOR color = level->color;
+    double tactics;
+    for(r = 0; r < level->pick_rate; r++) out[r].parent = SEARCH_UNUSED;
+    // unused slots left behind by pivots with fewer moves than the pick rate
+    if(level->nodes[pivot].parent == SEARCH_UNUSED) return;
+    if((level->deadline > 0.0 && level->ply > 1 && stats_now_ms() >= level->deadline)
+    || (level->abort && __atomic_load_n(level->abort, __ATOMIC_RELAXED))) {
+        __atomic_store_n(&level->timed_out, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    search_replay(position, level->root, level->nodes, pivot, level->root_color);
+    board_undo_init(undo);
+    batch->n = 0;
+    m = board_generate_moves(position, color, moves);
+    for(i = 0; i < m; i++) {
+        move = moves + i;
+        if(move->err < 0 || move->pruned) continue;
+        // only captures have to be played, quiet moves are rated from their deltas
+        if(!move->exact && board_make_move(position, undo, move->place % position->size, move->place / position->size, color) < 0) continue;
+        level->nodes_rated[worker]++;
+        STAT_ADD(nodes[STATS_DEPTH(level->ply)], 1);
+        candidates[n].move = move->place;
+        candidates[n].tactics = rate_self_atari(move);
+        candidates[n].key = move->exact ? move->key : board_key(position);
+        // ratings are cached from the perspective of the player who just moved,
+        // transpositions within the ply are dropped by beam_dedup afterwards
+        tt->probes++;
+        if(tt_probe(candidates[n].key, &cached)) {
+            tt->hits++;
+            candidates[n].score = cached.rating + candidates[n].tactics;
+            tt->saved_ratings++;
+        } else {
+            // scored together with the siblings once all moves are known
+            if(move->exact) move_features(position, color, move, &features);
+            else rating_features(position, color, &features);
+            rating_batch_add(batch, &features, n);
+        }
+        if(!move->exact) board_unmake_move(position, undo);
+        n++;
+    }
+    if(n == 0) {
+        __atomic_store_n(&level->exhausted, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    rating_batch_score(batch);
+    for(i = 0; i < batch->n; i++) candidates[batch->slot[i]].score = batch->score[i] + candidates[batch->slot[i]].tactics;
+    r = level->pick_rate;
+    if(r > n) r = n;
+    // fights the static rating can't see are read out for the best candidates
+    // before the picks are made, the table keeps the static rating
+    t = r * BEAM_TACTICS_SPREAD;
+    if(t > n) t = n;
+    candidate_top(candidates, n, t);
+    for(i = 0; i < t; i++) {
+        if(!tactics_near(position, candidates[i].move)) continue;
+        if(board_make_move(position, undo, candidates[i].move % position->size, candidates[i].move / position->size, color) < 0) continue;
+        // the reading replaces the self-atari guess
+        tactics = rate_tactics(position, undo, level->tactics + worker, color, candidates[i].move);
+        candidates[i].score += tactics - candidates[i].tactics;
+        candidates[i].tactics = tactics;
+        board_unmake_move(position, undo);
+    }
+    candidate_top(candidates, t, r);
+    for(n = 0; n < r; n++) {
+        out[n].key = candidates[n].key;
+        out[n].score = candidates[n].score;
+        out[n].parent = pivot;
+        out[n].best_child = -1;
+        out[n].move = candidates[n].move;
+        tt_store(candidates[n].key, candidates[n].score - candidates[n].tactics, -1, level->ply, level->generation);
+        tt->stores++;
+    }
+}
+
+// drops children transposing into a position an earlier pivot of the ply already
+// holds, walked in pivot order once the ply is done so the beam is the same for
+// any number of threads
+static void beam_dedup(BEAM_LEVEL *level, int start, int end, TT_STATS *tt) {
+    uint64_t *seen = level->seen, key;
+    int mask = level->seen_mask, i, h;
+    memset(seen, 0, sizeof(uint64_t) * (mask + 1));
+    for(i = start; i < end; i++) {
+        if(level->nodes[i].parent < 0) continue;
+        key = level->nodes[i].key ? level->nodes[i].key : 1;   // 0 marks a free slot
+        for(h = key & mask; seen[h] && seen[h] != key; h = (h + 1) & mask);
+        if(seen[h]) {
+            level->nodes[i].parent = SEARCH_UNUSED;
+            tt->saved_nodes++;
+        } else {
+            seen[h] = key;
+        }
+    }
+}
+
+// whether color wins the game if it ends now: the count has to be settled, with
+// few neutral points left, and won both with the estimated dead stones taken
+// off and by the plain count, so an estimate gone wrong never ends a game
+static int board_pass_wins(BOARD *board, CELL_COLOR color) {
+    AREA_SCORE area;
+    int estimated = board_score_area(board, DEFAULT_KOMI, 1, &area), plain = board_score_area(board, DEFAULT_KOMI, 0, NULL);
+    if(area.dame > board->square / PASS_DAME_SHARE) return 0;
+    return color == BLACK ? estimated > 0 && plain > 0 : estimated < 0 && plain < 0;
+}
+
 int board_predict(BOARD* board, CELL_COLOR color, int *best_x, int *best_y) {
+    return board_predict_beam(board, color, NULL, NULL, best_x, best_y);
+}
+
+int board_predict_beam(BOARD* board, CELL_COLOR color, SEARCH_PARAMS *params, SEARCH_STATS *stats, int *best_x, int *best_y) {
     CELL_COLOR o_color = color;
     int pick_rates[] = {5, 2, 5, 2, 5},
-        y = 0,
-        x = 0,
-        n = 0, // board number
-        m = 1, // number of boards
-        o = 0, // number of boards tmp var
-        p = 0, // board id
-        r = 0, // selected pick rate
+        m = 1, // number of nodes
         d = 0,
-        ok = 0,
+        w = 0,
         pivot = 0,
         sector_start = 0,
         sector_end = 1,
         to_alloc = 1,
-        last_pow; 
+        threads = pool_threads(),
+        seen_size = 2,
+        node_limit = params && params->nodes > 0 ? params->nodes : 0;
     int depth = sizeof(pick_rates) / sizeof(pick_rates[0]);
     int premature = 0;
+    uint64_t nodes_rated = 0;
+    TT_DATA cached;
+    TT_STATS tt = {0};
     int sizes[50];
     int stops[50][2];
-    double pass = 0.0, pass_big = 0.0;
+    double pass = 0.0, started = stats_now_ms();
+    ARENA *arena = arena_local();
+    BEAM_LEVEL *level;
+    SEARCH_NODE *nodes, *sel;
 
     sizes[0] = 1;
-    last_pow = pick_rates[0];
     for(d = 0; d < depth; d++) {
         to_alloc += sizes[d + 1] = sizes[d] * pick_rates[d];
+        while(seen_size < sizes[d + 1] * 2) seen_size *= 2;
     }
 
-    BOARD *boards = calloc(to_alloc, sizeof(BOARD)), *sel;
-    BOARD helper[board->square];
-    if(!boards) {
+    arena_reset(arena);
+    if(arena_reserve(arena,
+            ARENA_SIZE(sizeof(BEAM_LEVEL))
+            + ARENA_SIZE(sizeof(SEARCH_NODE) * to_alloc)
+            + ARENA_SIZE(sizeof(BOARD) * threads)
+            + ARENA_SIZE(sizeof(UNDO_STACK) * threads)
+            + ARENA_SIZE(sizeof(SEARCH_CANDIDATE) * board->square * threads)
+            + ARENA_SIZE(sizeof(MOVE_INFO) * board->square * threads)
+            + ARENA_SIZE(sizeof(RATING_BATCH) * threads)
+            + ARENA_SIZE(sizeof(TACTICS_CACHE) * threads)
+            + ARENA_SIZE(sizeof(uint64_t) * seen_size)) < 0) {
         *best_x = -1;
         *best_y = -1;
         return ERR_PASS;
     }
-    board_copy(boards, board);
-    boards->id = 0;
-    boards->parent = NULL;
-    boards->best_child = NULL;
-    boards->id = ERR_PASS;
-    boards->score = make_rating(boards, color);
-    pass = boards->score;
-    pass_big = boards->score;
-    if(pass > 0.0) pass = (1.0 - PASS_SPREAD) * pass;
-    else pass = (1.0 + PASS_SPREAD) * pass;
-    if(pass_big > 0.0) pass_big = (1.0 - PASS_SPREAD_BIG) * pass;
-    else pass_big = (1.0 + PASS_SPREAD_BIG) * pass_big;
+    level = (BEAM_LEVEL*)arena_alloc(arena, sizeof(BEAM_LEVEL));
+    nodes = (SEARCH_NODE*)arena_alloc(arena, sizeof(SEARCH_NODE) * to_alloc);
+    level->positions = (BOARD*)arena_alloc(arena, sizeof(BOARD) * threads);
+    level->undo = (UNDO_STACK*)arena_alloc(arena, sizeof(UNDO_STACK) * threads);
+    level->candidates = (SEARCH_CANDIDATE*)arena_alloc(arena, sizeof(SEARCH_CANDIDATE) * board->square * threads);
+    level->moves = (MOVE_INFO*)arena_alloc(arena, sizeof(MOVE_INFO) * board->square * threads);
+    level->batches = (RATING_BATCH*)arena_alloc(arena, sizeof(RATING_BATCH) * threads);
+    level->tactics = (TACTICS_CACHE*)arena_alloc(arena, sizeof(TACTICS_CACHE) * threads);
+    level->seen = (uint64_t*)arena_alloc(arena, sizeof(uint64_t) * seen_size);
+    level->seen_mask = seen_size - 1;
+    for(w = 0; w < threads; w++) tactics_cache_clear(level->tactics + w);
+    memset(level->tt, 0, sizeof(level->tt));
+    memset(level->nodes_rated, 0, sizeof(level->nodes_rated));
+    level->root = level->positions;
+    level->nodes = nodes;
+    level->root_color = color;
+    level->generation = tt_next_generation();
+    level->deadline = params && params->time_ms > 0 ? started + params->time_ms : 0.0;
+    level->abort = params ? params->abort : NULL;
+
+    // the root is rated on the first worker's scratch board with the right side to move
+    board_copy(level->root, board);
+    board_set_turn(level->root, color);
+    nodes->key = board_key(level->root);
+    nodes->parent = -1;
+    nodes->best_child = -1;
+    nodes->move = ERR_PASS;
+    nodes->score = make_rating(level->root, color);
+    pass = nodes->score;
+    // replays start from the caller's board, scratch boards are free to be overwritten
+    level->root = board;
 
     stops[0][0] = 0; stops[0][1] = 1;
+    level->timed_out = 0;
     for(d=0; d < depth; d++) {
-        for(pivot = sector_start; pivot < sector_end; pivot++) {
-            n = 0;
-            for(y = 0, p = 0; y < board->size; y++) {
-                for(x = 0; x < board->size; x++, p++) {
-                    board_copy(helper + n, boards + pivot);
-                    ok = board_place(helper + n, x, y, color);
-                    if(ok < 0) continue;
-                    helper[n].parent = boards + pivot;
-                    helper[n].id = p;
-                    helper[n].best_child = NULL;
-                    helper[n].score = make_rating(helper + n, color); // + 1000.0 * (0.9 + rnd() * 0.2);
-                    n++;
-                }
-            }
-            o = n;
-            if(n == 0) {
-                printf("prematurely closing search as no good moves were found %d / %d\n", d + 1, depth);
-                premature = 1;
-                depth = d - 1;
-                if(depth % 2 == 0) depth--;
-                break;
-            }
-            r = pick_rates[d];
-            if(r > n) r = n;
-            qsort(helper, n, sizeof(BOARD), rating_sort);
-            for(n = 0; n < r; n++, m++) {
-                board_copy(boards + m, helper + n);
-            }
+        // a ply that could overrun the node budget is not started, every pivot rates at most one child per point
+        if(d > 0 && node_limit) {
+            for(w = 0, nodes_rated = 0; w < threads; w++) nodes_rated += level->nodes_rated[w];
+            if(nodes_rated + (uint64_t)(sector_end - sector_start) * board->square > (uint64_t)node_limit) level->timed_out = 1;
+        }
+        if(!level->timed_out) {
+            level->color = color;
+            level->sector_start = sector_start;
+            level->children = sector_end;
+            level->pick_rate = pick_rates[d];
+            level->ply = d + 1;
+            level->exhausted = 0;
+            pool_run(beam_expand, level, sector_end - sector_start);
+            m = sector_end + (sector_end - sector_start) * pick_rates[d];
+            beam_dedup(level, sector_end, m, &tt);
+        }
+        if(level->timed_out) {
+            // out of budget, back up the complete plies ending on one of our own moves
+            STAT_LOG("search budget reached at %d / %d\n", d + 1, depth);
+            depth = d;
+            if(depth % 2 == 0) depth--;
+            break;
+        }
+        if(level->exhausted) {
+            STAT_LOG("prematurely closing search as no good moves were found %d / %d\n", d + 1, depth);
+            premature = 1;
+            depth = d - 1;
+            if(depth % 2 == 0) depth--;
+            break;
         }
         sector_start = sector_end;
         sector_end = m;
@@ -375,40 +1354,164 @@ int board_predict(BOARD* board, CELL_COLOR color, int *best_x, int *best_y) {
     }
 
     color = o_color;
+    nodes_rated = 0;
+    for(w = 0; w < threads; w++) {
+        tt.probes += level->tt[w].probes;
+        tt.hits += level->tt[w].hits;
+        tt.stores += level->tt[w].stores;
+        tt.saved_ratings += level->tt[w].saved_ratings;
+        tt.saved_nodes += level->tt[w].saved_nodes;
+        nodes_rated += level->nodes_rated[w];
+    }
 
     for(d = depth; d > 0; d--) {
         for(pivot = stops[d][0]; pivot < stops[d][1]; pivot++) {
-            sel = boards + pivot;
-            if(sel->parent->best_child == NULL || sel->score > sel->parent->score) {
-                sel->parent->best_child = sel;
-                sel->parent->score = sel->score;
+            sel = nodes + pivot;
+            if(sel->parent < 0) continue;
+            if(nodes[sel->parent].best_child < 0 || sel->score > nodes[sel->parent].score) {
+                nodes[sel->parent].best_child = pivot;
+                nodes[sel->parent].score = sel->score;
             }
         }
     }
 
-    sel = boards[0].best_child;
-    //printf("best move: %d, %d\n", sel->id % sel->size, sel->id / sel->size);
-    printf("score: %f, pass: %f, premature: %d\n", sel ? sel->score : 0, pass, premature);
+    // remember best replies of expanded positions, their static rating stays intact
+    for(pivot = 1; pivot < m; pivot++) {
+        sel = nodes + pivot;
+        if(sel->parent < 0 || sel->best_child < 0) continue;
+        if(tt_probe(sel->key, &cached)) {
+            tt_store(sel->key, cached.rating, nodes[sel->best_child].move, cached.ply, cached.generation);
+            tt.stores++;
+        }
+    }
+    // the root key was taken with color to move, the caller's board keeps its turn
+    if(nodes->best_child >= 0) {
+        tt_store(nodes->key, make_rating(board, color == BLACK ? WHITE : BLACK), nodes[nodes->best_child].move, 0, level->generation);
+        tt.stores++;
+    }
+    tt_account(&tt);
 
-    if( 
-        sel == NULL 
-        || sel->id < 0 
-        || (!premature && sel->score < pass) 
-        || ( premature && sel->score < pass_big /*&& d % 2 == 0*/)
-        //|| ( premature && sel->score < pass && d % 2 == 1)
+    if(stats) {
+        stats->nodes = nodes_rated;
+        stats->depth = depth;
+        stats->elapsed_ms = stats_now_ms() - started;
+    }
+
+    sel = nodes->best_child >= 0 ? nodes + nodes->best_child : NULL;
+    //printf("best move: %d, %d\n", sel->move % board->size, sel->move / board->size);
+    STAT_LOG("score: %f, pass: %f, premature: %d\n", sel ? sel->score : 0, pass, premature);
+    STAT_LOG("tt: %llu / %llu hits, saved ratings: %llu, saved nodes: %llu\n",
+        (unsigned long long)tt.hits, (unsigned long long)tt.probes, (unsigned long long)tt.saved_ratings, (unsigned long long)tt.saved_nodes);
+
+    // the count decides passing: with a move left the engine only passes once
+    // the game is settled, it wins by area and no line it found beats standing still
+    if(
+        sel == NULL
+        || sel->move < 0
+        || (sel->score < pass && board_pass_wins(board, color))
     ) {
         *best_x = -1;
         *best_y = -1;
-        free(boards);
         return ERR_PASS;
     }
-    *best_x = sel->id % board->size;
-    *best_y = sel->id / board->size;
-    free(boards);
-    printf("blk: %d, wht: %d\n", board->black_groups, board->white_groups);
+    *best_x = sel->move % board->size;
+    *best_y = sel->move / board->size;
+    STAT_LOG("blk: %d, wht: %d\n", board->black_groups, board->white_groups);
     return board_place(board, *best_x, *best_y, color);
 }
 
+// canonical position key plus the search setting that produced the reply,
+// mirrored and rotated positions share one entry
+uint64_t search_cache_key(uint64_t position, SEARCH_PARAMS *search) {
+    uint64_t setting = 0;
+    if(search) {
+        setting = (uint64_t)search->engine << 48 ^ (uint64_t)search->playouts << 32
+                ^ (uint64_t)search->time_ms << 16 ^ (uint64_t)search->nodes;
+    }
+    return position ^ ((setting + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+// replies from the opening book, the last pondering and the position cache are
+// stored in canonical orientation and replayed, a key collision that produces
+// an illegal move falls back to a search, the book answers for every search setting
+int board_search_cached(BOARD *board, SEARCH_PARAMS *search, SEARCH_STATS *stats, int *x, int *y) {
+    uint64_t position, key;
+    int move, depth, ok, symmetry_index = board_canonical(board, &position);
+    key = search_cache_key(position, search);
+    if(book_probe(position, &move, &depth) || ponder_probe(key, &move, &depth) || cache_probe(key, &move, &depth)) {
+        move = board_from_canonical(board, symmetry_index, move);
+        ok = ERR_PASS;
+        *x = -1;
+        *y = -1;
+        if(move >= 0 && move < board->square) {
+            *x = move % board->size;
+            *y = move / board->size;
+            ok = board_place(board, *x, *y, board->turn);
+        }
+        if(ok >= 0 || (ok == ERR_PASS && move < 0)) {
+            if(stats) {
+                stats->nodes = 0;
+                stats->depth = depth;
+                stats->elapsed_ms = 0.0;
+            }
+            return ok;
+        }
+    }
+    ok = board_search(board, board->turn, search, stats, x, y);
+    // an aborted search stopped short of its budget, its reply isn't shared
+    if(SEARCH_ABORTED(search)) return ok;
+    if(ok >= 0) cache_store(key, board_to_canonical(board, symmetry_index, *y * board->size + *x), stats ? stats->depth : 0);
+    else if(ok == ERR_PASS) cache_store(key, -1, stats ? stats->depth : 0);
+    return ok;
+}
+
+// plays the opponent's move or pass at x, y and, if asked to, the reply of
+// the engine to move next, which is written back to x, y
+int board_play(BOARD *board, int *x, int *y, int predict, int pass, SEARCH_PARAMS *search, SEARCH_STATS *stats) {
+    int ok = 0;
+    if(!pass) {
+        ok = board_place(board, *x, *y, board->turn);
+    } else {
+        board_refresh(board, -1, -1, board->turn, 0);
+    }
+    if(ok >= 0) {
+        board_set_turn(board, board->turn == BLACK ? WHITE : BLACK);
+        if(predict) {
+            if(pass && board_pass_wins(board, board->turn)) {
+                // passing back ends the game, no search does better than a won count
+                ok = ERR_PASS;
+                *x = -1;
+                *y = -1;
+                if(stats) memset(stats, 0, sizeof(SEARCH_STATS));
+            } else {
+                ok = board_search_cached(board, search, stats, x, y);
+            }
+            if(ok >= 0 || ok == ERR_PASS) {
+                if(ok == ERR_PASS) board_set_ko(board, -1);
+                board_set_turn(board, board->turn == BLACK ? WHITE : BLACK);
+            }
+        }
+    }
+    return ok;
+}
+
+int board_search(BOARD* board, CELL_COLOR color, SEARCH_PARAMS *params, SEARCH_STATS *stats, int *best_x, int *best_y) {
+    SEARCH_ENGINE engine = params ? params->engine : ENGINE_BEAM;
+    double started = stats_now_ms();
+    int ok;
+    if(engine == ENGINE_MCTS) {
+        ok = board_predict_mcts(board, color, params, stats, best_x, best_y);
+    } else if(engine == ENGINE_ALPHABETA) {
+        ok = board_predict_alphabeta(board, color, params, stats, best_x, best_y);
+    } else {
+        engine = ENGINE_BEAM;
+        ok = board_predict_beam(board, color, params, stats, best_x, best_y);
+    }
+    STAT_ADD(searches[engine], 1);
+    STAT_ADD(search_us[engine], (uint64_t)((stats_now_ms() - started) * 1000.0));
+    return ok;
+}
+
 void board_encode(BOARD *board, char *out, size_t size) {
     if(size < (board->square + 30)) {
         *out = 0;
@@ -433,14 +1536,13 @@ void board_encode(BOARD *board, char *out, size_t size) {
     *p = 0;
 }
 
-BOARD *board_decode(const char *text) {
+static int board_decode_text(BOARD *board, const char *text) {
     int size, turn, ko, white, black;
                         //0 0000 0000 0000 0000
     int n = sscanf(text, "%01d %04d %04d %04d %04d", &turn, &size, &ko, &black, &white);
-    if(n != 5) return NULL;
-    BOARD *board = (BOARD*)allocate(NULL, sizeof(BOARD));
-    if(!board) return NULL;
-    board_init(board, size, 65);
+    if(n != 5 || size < 1 || size > MAX_BOARD || (turn != BLACK && turn != WHITE)) return -1;
+    if(ko < -1 || ko >= size * size) ko = -1;
+    board_init(board, size, DEFAULT_KOMI);
     board->turn = turn;
     board->ko = ko;
     board->white_score = white;
@@ -451,9 +1553,117 @@ BOARD *board_decode(const char *text) {
         board->cells[n].color = *text == '+' ? EMPTY : (*text == 'X' ? BLACK : WHITE);
         text++; n++;
     }
+    board_rebuild(board);
+    return 0;
+}
+
+BOARD *board_decode(const char *text) {
+    BOARD *board = (BOARD*)allocate(NULL, sizeof(BOARD));
+    if(!board) return NULL;
+    if(board_decode_text(board, text) < 0) {
+        allocate(board, 0);
+        return NULL;
+    }
     return board;
 }
 
+static const char base64url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+static signed char base64url_values[256];
+
+int board_pack(BOARD *board, const short *history, int n_history, unsigned char *out, size_t size) {
+    int i, bytes = (board->square + 3) / 4, total;
+    if(n_history < 0 || n_history > SESSION_MAX_HISTORY) return -1;
+    total = SESSION_HEADER + bytes + 2 * n_history;
+    if(size < (size_t)total) return -1;
+    out[0] = 0x80 | SESSION_VERSION;
+    out[1] = board->size | (board->turn << 5);
+    out[2] = (board->ko + 1) & 0xFF;
+    out[3] = (board->ko + 1) >> 8;
+    out[4] = (unsigned short)board->black_score & 0xFF;
+    out[5] = (unsigned short)board->black_score >> 8;
+    out[6] = (unsigned short)board->white_score & 0xFF;
+    out[7] = (unsigned short)board->white_score >> 8;
+    out[8] = n_history;
+    board->kernels->pack_cells(board, out + SESSION_HEADER);
+    out += SESSION_HEADER + bytes;
+    for(i = 0; i < n_history; i++) {
+        out[2 * i] = (history[i] + 1) & 0xFF;
+        out[2 * i + 1] = (history[i] + 1) >> 8;
+    }
+    return total;
+}
+
+// decodes into a caller owned board, history may be NULL, returns -1 on malformed input
+int board_unpack(BOARD *out, short *history, int *n_history, const unsigned char *in, size_t len) {
+    int i, size, turn, ko, bytes, n;
+    if(len < SESSION_HEADER || in[0] != (0x80 | SESSION_VERSION)) return -1;
+    size = in[1] & 31;
+    turn = in[1] >> 5;
+    ko = (in[2] | in[3] << 8) - 1;
+    n = in[8];
+    if(size < 1 || size > MAX_BOARD || (turn != BLACK && turn != WHITE)) return -1;
+    bytes = (size * size + 3) / 4;
+    if(len < (size_t)(SESSION_HEADER + bytes + 2 * n)) return -1;
+    if(ko < -1 || ko >= size * size) ko = -1;
+    board_init(out, size, DEFAULT_KOMI);
+    out->turn = turn;
+    out->ko = ko;
+    out->black_score = (short)(in[4] | in[5] << 8);
+    out->white_score = (short)(in[6] | in[7] << 8);
+    if(out->kernels->unpack_cells(out, in + SESSION_HEADER) < 0) return -1;
+    in += SESSION_HEADER + bytes;
+    if(n_history) *n_history = history ? n : 0;
+    for(i = 0; history && i < n; i++) history[i] = (short)((in[2 * i] | in[2 * i + 1] << 8) - 1);
+    board_rebuild(out);
+    return 0;
+}
+
+// unpadded base64url of board_pack, returns the length without terminator or -1
+int board_encode_session(BOARD *board, const short *history, int n_history, char *out, size_t size) {
+    unsigned char raw[SESSION_MAX_BYTES];
+    int n = board_pack(board, history, n_history, raw, sizeof(raw)), i, o = 0;
+    unsigned v;
+    if(n < 0 || size < (size_t)((n * 4 + 2) / 3 + 1)) return -1;
+    for(i = 0; i + 2 < n; i += 3) {
+        v = raw[i] << 16 | raw[i + 1] << 8 | raw[i + 2];
+        out[o++] = base64url[v >> 18];
+        out[o++] = base64url[(v >> 12) & 63];
+        out[o++] = base64url[(v >> 6) & 63];
+        out[o++] = base64url[v & 63];
+    }
+    if(i < n) {
+        v = raw[i] << 16 | (i + 1 < n ? raw[i + 1] << 8 : 0);
+        out[o++] = base64url[v >> 18];
+        out[o++] = base64url[(v >> 12) & 63];
+        if(i + 1 < n) out[o++] = base64url[(v >> 6) & 63];
+    }
+    out[o] = 0;
+    return o;
+}
+
+// accepts binary sessions as well as the text format of board_encode
+int board_decode_session(BOARD *out, short *history, int *n_history, const char *text, size_t len) {
+    unsigned char raw[SESSION_MAX_BYTES + 2];
+    int i, n = 0, bits = 0, invalid = 0;
+    unsigned acc = 0;
+    if(len > 0 && text[0] >= '0' && text[0] <= '9') {
+        if(n_history) *n_history = 0;
+        return board_decode_text(out, text);
+    }
+    if(len > SESSION_MAX_TEXT) return -1;
+    for(i = 0; i < (int)len; i++) {
+        invalid |= base64url_values[(unsigned char)text[i]] < 0;
+        acc = (acc << 6) | (base64url_values[(unsigned char)text[i]] & 63);
+        bits += 6;
+        if(bits >= 8) {
+            bits -= 8;
+            raw[n++] = acc >> bits;
+        }
+    }
+    if(invalid) return -1;
+    return board_unpack(out, history, n_history, raw, n);
+}
+
 void board_print(BOARD *board) {
     int n;
     CELL *cell;
@@ -481,8 +1691,40 @@ void board_print(BOARD *board) {
     printf("%s", picture);
 }
 
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
 void ai_init() {
-    int i;
+    int i, size, t, n, x, y;
+    uint64_t seed = 0x6775735F7A6F62ULL;
+    for(i = 0; i < MAX_SQUARE; i++) {
+        zobrist[BLACK][i] = splitmix64(&seed);
+        zobrist[WHITE][i] = splitmix64(&seed);
+        zobrist_ko[i] = splitmix64(&seed);
+    }
+    zobrist_turn = splitmix64(&seed);
+    for(size = 1; size <= MAX_BOARD; size++) {
+        for(t = 0; t < 8; t++) {
+            for(n = 0; n < size * size; n++) {
+                x = n % size;
+                y = n / size;
+                if(t & 4) {
+                    i = x; x = y; y = i;
+                }
+                if(t & 1) x = size - 1 - x;
+                if(t & 2) y = size - 1 - y;
+                symmetry[size][t][n] = y * size + x;
+                symmetry_back[size][t][y * size + x] = n;
+            }
+        }
+    }
+    pattern_init();
+    memset(base64url_values, -1, sizeof(base64url_values));
+    for(i = 0; i < 64; i++) base64url_values[(unsigned char)base64url[i]] = i;
     logs[0] = 1.0;
     group_bonus[0] = 0;
     group_bonus[1] = 500;
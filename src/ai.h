@@ -6,9 +6,11 @@
 
 struct cell;
 struct board;
-struct int_vec;
+struct board_kernels;
 
-#define MAX_BOARD 13
+#define MAX_BOARD 19
+#define MAX_SQUARE (MAX_BOARD * MAX_BOARD)
+#define DEFAULT_KOMI 65
 
 typedef enum go_err {
     NO_ERR = 0,
@@ -16,7 +18,8 @@ typedef enum go_err {
     ERR_OOB = -2,
     ERR_SUICIDE = -3,
     ERR_KO = -4,
-    ERR_PASS = -5
+    ERR_PASS = -5,
+    ERR_DEPTH = -6
 } GO_ERR;
 
 typedef enum cell_color {
@@ -29,15 +32,26 @@ typedef struct cell {
     CELL_COLOR color;
     short group;
     short n_liberties;
-    struct int_vec* liberties;
 } CELL;
 
+// persistent group records maintained incrementally by board_place,
+// all fields except head are only valid at group's head stone
+typedef struct group_state {
+    short head[MAX_SQUARE];
+    short next[MAX_SQUARE];
+    short stones[MAX_SQUARE];
+    short liberties[MAX_SQUARE];
+} GROUP_STATE;
+
 typedef struct board {
     char size;
     short square;
     char turn;
     short ko;
+    const struct board_kernels *kernels;    // hot loops specialized for the size, set by board_init
     CELL cells[MAX_BOARD * MAX_BOARD];
+    GROUP_STATE groups;
+    unsigned short patterns[MAX_SQUARE];    // 3x3 codes kept up to date for every point, see pattern.h
     // scoring params
     short white_score;
     short black_score;
@@ -47,28 +61,171 @@ typedef struct board {
     short black_groups;
     short white;
     short black;
-    short id;
-    double score;
-    double max;
-    struct board *parent;
-    struct board *best_child;
+    uint64_t hash;
 } BOARD;
 
-typedef struct int_vec {
-    int size;
-    int capacity;
-    int refs;
-    int on_stack;
-    int *values;
-} INT_VEC;
+#define MAX_UNDO_DEPTH 256
+#define MAX_UNDO_WRITES (16 * MAX_SQUARE)
+// upper bound of group record writes a single move can cause
+#define MAX_MOVE_WRITES(square) (8 * (square))
+
+typedef struct undo_write {
+    void *addr;
+    int old;
+    int is_color;
+} UNDO_WRITE;
+
+// board scalars are snapshotted per move, group records and colors are logged per write
+typedef struct undo_frame {
+    uint64_t hash;
+    int writes;
+    short ko;
+    short white_score;
+    short black_score;
+    short white_liberties;
+    short black_liberties;
+    short white_groups;
+    short black_groups;
+    short white;
+    short black;
+    char turn;
+} UNDO_FRAME;
+
+typedef struct undo_stack {
+    int n_frames;
+    int n_writes;
+    UNDO_FRAME frames[MAX_UNDO_DEPTH];
+    UNDO_WRITE writes[MAX_UNDO_WRITES];
+} UNDO_STACK;
+
+// outcome of a move computed from neighbouring group records without playing it,
+// feature deltas are from the mover's (my) and the opponent's (op) point of view
+typedef struct move_info {
+    uint64_t key;       // board_key of the resulting position, valid when exact
+    short place;
+    short err;          // NO_ERR, ERR_KO or ERR_SUICIDE
+    short captured;     // stones the move captures
+    short exact;        // capturing moves change liberties further away and must be played
+    short d_my_stones;
+    short d_my_groups;
+    short d_my_liberties;
+    short d_my_score;
+    short d_op_stones;
+    short d_op_groups;
+    short d_op_liberties;
+    short pruned;       // own eye by its 3x3 pattern, left out of the search
+    short self_atari;   // stones a quiet move leaves in atari, searched last and playouts skip it
+    float prior;        // weight of the point's 3x3 pattern, orders the remaining moves
+} MOVE_INFO;
+
+// linear weights of the static evaluation, see ai_load_weights
+typedef struct rating_weights {
+    double score;
+    double op_score;
+    double liberties;
+    double op_liberties;
+    double area;
+    double op_area;
+} RATING_WEIGHTS;
+
+// bump whenever the evaluation changes in code, books built before are refused
+#define EVAL_VERSION 4
+
+// binary session: 1 version byte, packed header, 2 bits per point, then an
+// optional history of n moves as little endian place + 1 (0 is a pass)
+#define SESSION_VERSION 1
+#define SESSION_HEADER 9
+#define SESSION_MAX_HISTORY 255
+#define SESSION_MAX_BYTES (SESSION_HEADER + (MAX_SQUARE + 3) / 4 + 2 * SESSION_MAX_HISTORY)
+#define SESSION_MAX_TEXT ((SESSION_MAX_BYTES * 4 + 2) / 3 + 1)
+
+#define SEARCH_UNUSED -2
+
+// compact search tree record, positions are replayed from the root on demand
+typedef struct search_node {
+    uint64_t key;
+    double score;
+    int parent;         // -1 for root, SEARCH_UNUSED for an empty slot
+    int best_child;
+    short move;         // board index of the move leading here
+} SEARCH_NODE;
+
+typedef struct search_candidate {
+    double score;
+    double tactics;     // part of the score from self-ataris and reading out weak groups, not cached
+    uint64_t key;
+    short move;
+} SEARCH_CANDIDATE;
+
+typedef enum search_engine {
+    ENGINE_BEAM = 0,
+    ENGINE_MCTS = 1,
+    ENGINE_ALPHABETA = 2
+} SEARCH_ENGINE;
+
+typedef struct search_params {
+    SEARCH_ENGINE engine;
+    int playouts;   // MCTS playout budget, 0 for no limit
+    int time_ms;    // wall clock budget, 0 for no limit
+    int nodes;      // node budget, 0 for no limit
+    int *abort;     // optional flag, the search returns early once it is set
+} SEARCH_PARAMS;
+
+#define SEARCH_ABORTED(params) ((params) && (params)->abort && __atomic_load_n((params)->abort, __ATOMIC_RELAXED))
+
+typedef struct search_stats {
+    uint64_t nodes;     // positions generated and rated
+    int depth;          // plies searched
+    double elapsed_ms;
+} SEARCH_STATS;
+
+#define LIBERTY_WORDS ((MAX_SQUARE + 63) / 64)
+
+// one bit per point, sets of a group's stones are merged with OR and counted with popcount
+typedef struct liberty_set {
+    uint64_t w[LIBERTY_WORDS];
+} LIBERTY_SET;
 
 void *allocate(void *mem, size_t size);
 void ai_init();
+void ai_set_weights(RATING_WEIGHTS *weights);
+int  ai_load_weights(const char *path);
+uint64_t ai_eval_fingerprint();
 void board_init(BOARD *board, int size, int komi);
 int  board_refresh(BOARD *board, int place_x, int place_y, CELL_COLOR color, int update);
 int  board_place(BOARD *board, int x, int y, CELL_COLOR color);
+int  board_place_reference(BOARD *board, int x, int y, CELL_COLOR color);
+void board_undo_init(UNDO_STACK *undo);
+int  board_make_move(BOARD *board, UNDO_STACK *undo, int x, int y, CELL_COLOR color);
+void board_unmake_move(BOARD *board, UNDO_STACK *undo);
+void board_rebuild(BOARD *board);
+void board_set_turn(BOARD *board, CELL_COLOR turn);
+void board_set_ko(BOARD *board, int ko);
+uint64_t board_key(BOARD *board);
+void board_move_info(BOARD *board, CELL_COLOR color, int place, MOVE_INFO *info);
+int  board_generate_moves(BOARD *board, CELL_COLOR color, MOVE_INFO *out);
+double board_rate(BOARD *board, CELL_COLOR color);
+double board_rate_move(BOARD *board, CELL_COLOR color, MOVE_INFO *info);
+double board_rate_child(BOARD *board, UNDO_STACK *undo, CELL_COLOR color, MOVE_INFO *info);
+int  board_verify(BOARD *board);
 int  board_predict(BOARD* board, CELL_COLOR color, int *best_x, int *best_y);
+int  board_predict_beam(BOARD* board, CELL_COLOR color, SEARCH_PARAMS *params, SEARCH_STATS *stats, int *best_x, int *best_y);
+int  board_predict_mcts(BOARD* board, CELL_COLOR color, SEARCH_PARAMS *params, SEARCH_STATS *stats, int *best_x, int *best_y);
+int  board_predict_alphabeta(BOARD* board, CELL_COLOR color, SEARCH_PARAMS *params, SEARCH_STATS *stats, int *best_x, int *best_y);
+int  board_play(BOARD *board, int *x, int *y, int predict, int pass, SEARCH_PARAMS *search, SEARCH_STATS *stats);
+uint64_t search_cache_key(uint64_t position, SEARCH_PARAMS *search);
+int  board_search_cached(BOARD *board, SEARCH_PARAMS *search, SEARCH_STATS *stats, int *x, int *y);
+int  board_search(BOARD* board, CELL_COLOR color, SEARCH_PARAMS *params, SEARCH_STATS *stats, int *best_x, int *best_y);
+void board_copy(BOARD *out, BOARD *board);
 void board_print(BOARD *board);
 void board_encode(BOARD *board, char *out, size_t buffer);
 BOARD *board_decode(const char *text);
+int  board_canonical(BOARD *board, uint64_t *key);
+int  board_to_canonical(BOARD *board, int symmetry, int place);
+int  board_from_canonical(BOARD *board, int symmetry, int place);
+void board_transform(BOARD *out, BOARD *board, int symmetry);
+int  board_pack(BOARD *board, const short *history, int n_history, unsigned char *out, size_t size);
+int  board_unpack(BOARD *out, short *history, int *n_history, const unsigned char *in, size_t len);
+int  board_encode_session(BOARD *board, const short *history, int n_history, char *out, size_t size);
+int  board_decode_session(BOARD *out, short *history, int *n_history, const char *text, size_t len);
 #endif
\ No newline at end of file
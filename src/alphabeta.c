@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <string.h>
+#include "ai.h"
+#include "tt.h"
+#include "arena.h"
+#include "stats.h"
+#include "tactics.h"
+
+#define AB_DEFAULT_DEPTH 4
+#define AB_MAX_PLY 32
+#define AB_INFINITY 1e300
+#define AB_TIER 1e12            // ordering bands: hash move, killers, captures, quiet moves, self-ataris
+#define AB_CLOCK_EVERY 16
+#define AB_MAX_URGENT 8         // moves the capture reader finds, ordered with the captures
+
+typedef struct ab_ply {
+    MOVE_INFO moves[MAX_SQUARE];
+    double order[MAX_SQUARE];
+    short killers[2];
+} AB_PLY;
+
+typedef struct ab_search {
+    BOARD position;
+    UNDO_STACK undo;
+    AB_PLY plies[AB_MAX_PLY];
+    double history[2][MAX_SQUARE];
+    TACTICS_CACHE tactics;
+    double deadline;
+    uint64_t node_limit;
+    uint64_t nodes;
+    uint64_t calls;
+    int generation;
+    int stopped;
+    int root_move;
+    int *abort;
+} AB_SEARCH;
+
+static int ab_urgent(short *urgent, int n, int place) {
+    int i;
+    for(i = 0; i < n; i++) {
+        if(urgent[i] == place) return 1;
+    }
+    return 0;
+}
+
+// value of the position for the side to move, the leaf value is the
+// static rating of the last move negated, so one-ply nodes need no recursion
+static double ab_negamax(AB_SEARCH *ab, int depth, int ply, double alpha, double beta, CELL_COLOR color) {
+    AB_PLY *frame = ab->plies + ply;
+    BOARD *position = &ab->position;
+    CELL_COLOR other = color == BLACK ? WHITE : BLACK;
+    MOVE_INFO *move, tmp_move;
+    TT_DATA cached;
+    uint64_t key = board_key(position);
+    double value, tmp_order, best = -AB_INFINITY;
+    short urgent[AB_MAX_URGENT];
+    int i, j, k, n, legal = 0, hint = -1, best_move = -1, n_urgent = 0;
+
+    if(ab->node_limit && ab->nodes >= ab->node_limit) ab->stopped = 1;
+    if(ab->abort && __atomic_load_n(ab->abort, __ATOMIC_RELAXED)) ab->stopped = 1;
+    if(ab->deadline > 0.0 && (++ab->calls % AB_CLOCK_EVERY) == 0 && stats_now_ms() >= ab->deadline) ab->stopped = 1;
+    if(ab->stopped) return 0.0;
+    if(tt_probe(key, &cached)) hint = cached.best;
+
+    n = board_generate_moves(position, color, frame->moves);
+    // ladder captures and escapes are only worth finding where moves get ordered
+    if(depth > 1) n_urgent = tactics_urgent(position, &ab->undo, &ab->tactics, color, urgent, AB_MAX_URGENT);
+    for(i = 0; i < n; i++) {
+        move = frame->moves + i;
+        frame->order[i] = -AB_INFINITY;
+        if(move->err < 0 || move->pruned) continue;
+        value = board_rate_child(&ab->position, &ab->undo, color, move);
+        if(value == -AB_INFINITY) continue;
+        legal++;
+        ab->nodes++;
+        STAT_ADD(nodes[STATS_DEPTH(ply + 1)], 1);
+        if(depth <= 1) {
+            if(value > best) {
+                best = value;
+                best_move = move->place;
+            }
+            continue;
+        }
+        if(move->place == hint) value += 3 * AB_TIER;
+        else if(move->place == frame->killers[0] || move->place == frame->killers[1]) value += 2 * AB_TIER;
+        else if(move->captured || ab_urgent(urgent, n_urgent, move->place)) value += AB_TIER;
+        else if(move->self_atari) value -= AB_TIER;
+        else value += ab->history[color][move->place] + move->prior;
+        frame->order[i] = value;
+    }
+    if(!legal) return -board_rate(position, other);
+
+    if(depth > 1) {
+        for(i = 0; i < n; i++) {
+            // incremental selection, a cutoff usually comes before the list is sorted
+            for(j = i + 1, k = i; j < n; j++) {
+                if(frame->order[j] > frame->order[k]) k = j;
+            }
+            if(frame->order[k] == -AB_INFINITY) break;
+            tmp_move = frame->moves[i]; frame->moves[i] = frame->moves[k]; frame->moves[k] = tmp_move;
+            tmp_order = frame->order[i]; frame->order[i] = frame->order[k]; frame->order[k] = tmp_order;
+            move = frame->moves + i;
+
+            if(board_make_move(position, &ab->undo, move->place % position->size, move->place / position->size, color) < 0) continue;
+            value = -ab_negamax(ab, depth - 1, ply + 1, -beta, -alpha, other);
+            board_unmake_move(position, &ab->undo);
+            if(ab->stopped) break;
+
+            if(value > best) {
+                best = value;
+                best_move = move->place;
+            }
+            if(value > alpha) alpha = value;
+            if(alpha >= beta) {
+                if(!move->captured) {
+                    if(frame->killers[0] != move->place) {
+                        frame->killers[1] = frame->killers[0];
+                        frame->killers[0] = move->place;
+                    }
+                    ab->history[color][move->place] += depth * depth;
+                }
+                break;
+            }
+        }
+    }
+
+    if(ply == 0 && best_move >= 0) ab->root_move = best_move;
+    // the entry keeps the static rating the beam search expects next to the best reply
+    if(!ab->stopped && best_move >= 0) tt_store(key, board_rate(position, other), best_move, ply, ab->generation);
+    return best;
+}
+
+// iterative deepening negamax with alpha-beta pruning, searches to AB_DEFAULT_DEPTH
+// or, when a time or node budget is given, as deep as the budget allows
+int board_predict_alphabeta(BOARD* board, CELL_COLOR color, SEARCH_PARAMS *params, SEARCH_STATS *stats, int *best_x, int *best_y) {
+    ARENA *arena = arena_local();
+    AB_SEARCH *ab;
+    double started = stats_now_ms(), value, score = 0.0;
+    int depth, max_depth, i, best = -1, completed = 0;
+
+    arena_reset(arena);
+    if(arena_reserve(arena, ARENA_SIZE(sizeof(AB_SEARCH))) < 0) {
+        *best_x = -1;
+        *best_y = -1;
+        return ERR_PASS;
+    }
+    ab = (AB_SEARCH*)arena_alloc(arena, sizeof(AB_SEARCH));
+    board_copy(&ab->position, board);
+    board_set_turn(&ab->position, color);
+    board_undo_init(&ab->undo);
+    memset(ab->history, 0, sizeof(ab->history));
+    tactics_cache_clear(&ab->tactics);
+    for(i = 0; i < AB_MAX_PLY; i++) {
+        ab->plies[i].killers[0] = -1;
+        ab->plies[i].killers[1] = -1;
+    }
+    ab->deadline = params && params->time_ms > 0 ? started + params->time_ms : 0.0;
+    ab->node_limit = params && params->nodes > 0 ? params->nodes : 0;
+    ab->nodes = 0;
+    ab->calls = 0;
+    ab->generation = tt_next_generation();
+    ab->stopped = 0;
+    ab->abort = params ? params->abort : NULL;
+
+    max_depth = ab->deadline > 0.0 || ab->node_limit ? AB_MAX_PLY - 1 : AB_DEFAULT_DEPTH;
+    for(depth = 1; depth <= max_depth && !ab->stopped; depth++) {
+        // the previous best move is tried first through the table, so a partial
+        // iteration only replaces it with a move that proved better
+        ab->root_move = -1;
+        value = ab_negamax(ab, depth, 0, -AB_INFINITY, AB_INFINITY, color);
+        if(ab->root_move < 0) break;
+        best = ab->root_move;
+        if(!ab->stopped) {
+            completed = depth;
+            score = value;
+        }
+    }
+
+    if(stats) {
+        stats->nodes = ab->nodes;
+        stats->depth = completed;
+        stats->elapsed_ms = stats_now_ms() - started;
+    }
+    STAT_LOG("ab: depth: %d, nodes: %llu, score: %f\n", completed, (unsigned long long)ab->nodes, score);
+    if(best < 0) {
+        *best_x = -1;
+        *best_y = -1;
+        return ERR_PASS;
+    }
+    *best_x = best % board->size;
+    *best_y = best / board->size;
+    return board_place(board, *best_x, *best_y, color);
+}
@@ -0,0 +1,40 @@
+#include "arena.h"
+#include "ai.h"
+
+static __thread ARENA local_arena;
+
+ARENA *arena_local() {
+    return &local_arena;
+}
+
+// makes sure bytes fit from the start, only grows and invalidates older pointers
+int arena_reserve(ARENA *arena, size_t bytes) {
+    char *base;
+    if(bytes <= arena->capacity) return 0;
+    base = (char*)allocate(arena->base, bytes);
+    if(!base) return -1;
+    arena->base = base;
+    arena->capacity = bytes;
+    arena->used = 0;
+    return 0;
+}
+
+void *arena_alloc(ARENA *arena, size_t bytes) {
+    size_t offset = (ARENA_ALIGN - ((size_t)(arena->base + arena->used) & (ARENA_ALIGN - 1))) & (ARENA_ALIGN - 1);
+    void *mem;
+    if(arena->used + offset + bytes > arena->capacity) return NULL;
+    mem = arena->base + arena->used + offset;
+    arena->used += offset + bytes;
+    return mem;
+}
+
+void arena_reset(ARENA *arena) {
+    arena->used = 0;
+}
+
+void arena_release(ARENA *arena) {
+    if(arena->base) allocate(arena->base, 0);
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef __S80_GUS_ARENA__
+#define __S80_GUS_ARENA__
+#include <stdlib.h>
+
+#define ARENA_ALIGN 64
+// bytes to reserve for one allocation of given size including its alignment slack
+#define ARENA_SIZE(bytes) ((bytes) + ARENA_ALIGN)
+
+// bump allocator that keeps its block between uses, once a thread has seen
+// its largest search every following search allocates nothing
+typedef struct arena {
+    char *base;
+    size_t capacity;
+    size_t used;
+} ARENA;
+
+ARENA *arena_local();
+int   arena_reserve(ARENA *arena, size_t bytes);
+void *arena_alloc(ARENA *arena, size_t bytes);
+void  arena_reset(ARENA *arena);
+void  arena_release(ARENA *arena);
+#endif
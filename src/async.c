@@ -0,0 +1,133 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include "ai.h"
+#include "arena.h"
+#include "async.h"
+
+// jobs run in submission order on their own threads, separate from the search
+// pool, a search started here still fans out over the pool when it's free
+static struct {
+    pthread_t threads[ASYNC_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    ASYNC_JOB *head;
+    ASYNC_JOB *tail;
+    int n_threads;
+    int stop;
+} queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER
+};
+
+static void async_signal(ASYNC_JOB *job) {
+    uint64_t one = 1;
+    ssize_t written;
+    __atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+#ifdef __linux__
+    written = write(job->fds[1], &one, sizeof(one));
+#else
+    written = write(job->fds[1], &one, 1);
+#endif
+    (void)written;
+}
+
+static void *async_main(void *arg) {
+    ASYNC_JOB *job;
+    for(;;) {
+        pthread_mutex_lock(&queue.lock);
+        while(!queue.head && !queue.stop) pthread_cond_wait(&queue.wake, &queue.lock);
+        job = queue.head;
+        if(job) {
+            queue.head = job->next;
+            if(!queue.head) queue.tail = NULL;
+        }
+        pthread_mutex_unlock(&queue.lock);
+        if(!job) {
+            // searches ran on this thread, their arena goes with it
+            arena_release(arena_local());
+            return NULL;
+        }
+        job->task(job->ctx);
+        async_signal(job);
+    }
+}
+
+int async_init(int threads) {
+    int i;
+    async_release();
+    if(threads < 1) threads = 1;
+    if(threads > ASYNC_MAX_THREADS) threads = ASYNC_MAX_THREADS;
+    queue.stop = 0;
+    for(i = 0; i < threads; i++) {
+        if(pthread_create(queue.threads + i, NULL, async_main, NULL) != 0) break;
+    }
+    queue.n_threads = i;
+    return i == threads ? 0 : -1;
+}
+
+// lets the threads drain the queue, jobs still queued are completed first
+void async_release() {
+    int i;
+    if(queue.n_threads == 0) return;
+    pthread_mutex_lock(&queue.lock);
+    queue.stop = 1;
+    pthread_cond_broadcast(&queue.wake);
+    pthread_mutex_unlock(&queue.lock);
+    for(i = 0; i < queue.n_threads; i++) pthread_join(queue.threads[i], NULL);
+    queue.n_threads = 0;
+}
+
+// returns NULL if there are no threads or the completion fd can't be created
+ASYNC_JOB *async_submit(ASYNC_TASK task, void *ctx) {
+    ASYNC_JOB *job;
+    if(queue.n_threads == 0) return NULL;
+    job = (ASYNC_JOB*)allocate(NULL, sizeof(ASYNC_JOB));
+    if(!job) return NULL;
+#ifdef __linux__
+    job->fds[0] = job->fds[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(job->fds[0] < 0) {
+#else
+    if(pipe(job->fds) < 0) {
+#endif
+        allocate(job, 0);
+        return NULL;
+    }
+    job->task = task;
+    job->ctx = ctx;
+    job->done = 0;
+    job->next = NULL;
+    pthread_mutex_lock(&queue.lock);
+    if(queue.tail) queue.tail->next = job;
+    else queue.head = job;
+    queue.tail = job;
+    pthread_cond_signal(&queue.wake);
+    pthread_mutex_unlock(&queue.lock);
+    return job;
+}
+
+int async_fd(ASYNC_JOB *job) {
+    return job->fds[0];
+}
+
+int async_done(ASYNC_JOB *job) {
+    return __atomic_load_n(&job->done, __ATOMIC_ACQUIRE);
+}
+
+void async_wait(ASYNC_JOB *job) {
+    struct pollfd pfd;
+    pfd.fd = job->fds[0];
+    pfd.events = POLLIN;
+    while(!async_done(job)) poll(&pfd, 1, -1);
+}
+
+// only for finished jobs, the caller owns ctx
+void async_free(ASYNC_JOB *job) {
+    close(job->fds[0]);
+    if(job->fds[1] != job->fds[0]) close(job->fds[1]);
+    allocate(job, 0);
+}
@@ -0,0 +1,25 @@
+#ifndef __S80_GUS_ASYNC__
+#define __S80_GUS_ASYNC__
+
+#define ASYNC_MAX_THREADS 64
+
+typedef void (*ASYNC_TASK)(void *ctx);
+
+// a queued task, its fd becomes readable once the task has finished so an
+// event loop can watch it next to its sockets instead of blocking on it
+typedef struct async_job {
+    ASYNC_TASK task;
+    void *ctx;
+    int fds[2];     // read and write end, the same eventfd on linux
+    int done;
+    struct async_job *next;
+} ASYNC_JOB;
+
+int  async_init(int threads);
+void async_release();
+ASYNC_JOB *async_submit(ASYNC_TASK task, void *ctx);
+int  async_fd(ASYNC_JOB *job);
+int  async_done(ASYNC_JOB *job);
+void async_wait(ASYNC_JOB *job);
+void async_free(ASYNC_JOB *job);
+#endif
@@ -0,0 +1,349 @@
+#ifdef GUS_BENCH
+#include <stdio.h>
+#include <string.h>
+#include "ai.h"
+#include "tt.h"
+#include "pool.h"
+#include "stats.h"
+#include "score.h"
+#include "tactics.h"
+
+#define BENCH_POSITIONS 8
+#define BENCH_SCORE_CALLS 200000
+#define BENCH_LADDER_READS 200
+
+// fixed budgets keep the runs reproducible, time budgets would not be
+typedef struct bench_engine {
+    const char *name;
+    SEARCH_PARAMS params;
+} BENCH_ENGINE;
+
+static const BENCH_ENGINE bench_engine_list[] = {
+    { "beam", { .engine = ENGINE_BEAM } },
+    { "mcts", { .engine = ENGINE_MCTS, .playouts = 300 } },
+    { "alphabeta", { .engine = ENGINE_ALPHABETA, .nodes = 20000 } }
+};
+
+#define BENCH_ENGINES ((int)(sizeof(bench_engine_list) / sizeof(bench_engine_list[0])))
+
+// the sizes with their own kernels and one that takes the generic path
+static const int bench_sizes[] = { 5, 9, 13, 19 };
+
+#define BENCH_SIZES ((int)(sizeof(bench_sizes) / sizeof(bench_sizes[0])))
+
+// totals of one suite run, latencies are kept per searched move
+typedef struct bench_run {
+    double *latencies;
+    int moves;
+    int capacity;
+    uint64_t nodes;
+    AI_STATS counters;  // totals when the run started
+    double started;
+} BENCH_RUN;
+
+// reproducible middle game positions: seeded random legal moves
+static void bench_position(BOARD *board, int size, int moves, unsigned seed) {
+    int i, tries;
+    board_init(board, size, DEFAULT_KOMI);
+    srand(seed);
+    for(i = 0; i < moves; i++) {
+        for(tries = 0; tries < 100; tries++) {
+            if(board_place(board, rand() % size, rand() % size, board->turn) >= 0) break;
+        }
+        board_set_turn(board, board->turn == BLACK ? WHITE : BLACK);
+    }
+}
+
+static void bench_begin(BENCH_RUN *run, int capacity) {
+    run->latencies = (double*)allocate(NULL, sizeof(double) * capacity);
+    run->capacity = run->latencies ? capacity : 0;
+    run->moves = 0;
+    run->nodes = 0;
+    stats_collect(&run->counters);
+    run->started = stats_now_ms();
+}
+
+static int bench_search(BENCH_RUN *run, BOARD *board, const BENCH_ENGINE *engine, int *x, int *y) {
+    SEARCH_PARAMS params = engine->params;
+    SEARCH_STATS stats;
+    double started = stats_now_ms();
+    int ok = board_search(board, board->turn, &params, &stats, x, y);
+    if(run->moves < run->capacity) run->latencies[run->moves] = stats_now_ms() - started;
+    run->moves++;
+    run->nodes += stats.nodes;
+    return ok;
+}
+
+static int bench_compare(const void *a, const void *b) {
+    double da = *(const double*)a, db = *(const double*)b;
+    return da < db ? -1 : da > db;
+}
+
+static double bench_percentile(BENCH_RUN *run, int n, int percent) {
+    return n ? run->latencies[(n - 1) * percent / 100] : 0.0;
+}
+
+// one key=value line per run, the counters include the work of the whole run
+static void bench_report(BENCH_RUN *run, const char *suite, int size, const char *engine, int games) {
+    AI_STATS counters;
+    double elapsed = stats_now_ms() - run->started;
+    int n = run->moves < run->capacity ? run->moves : run->capacity;
+    if(elapsed <= 0.0) elapsed = 1e-3;
+    stats_collect(&counters);
+    qsort(run->latencies, n, sizeof(double), bench_compare);
+    fprintf(stderr, "%s size=%d engine=%s games=%d moves=%d ms=%.2f moves_per_s=%.1f nps=%.0f places_per_s=%.0f refreshes_per_s=%.0f allocations=%llu p50_ms=%.3f p90_ms=%.3f p99_ms=%.3f max_ms=%.3f\n",
+        suite, size, engine, games, run->moves, elapsed, run->moves * 1000.0 / elapsed, run->nodes * 1000.0 / elapsed,
+        (counters.places - run->counters.places) * 1000.0 / elapsed, (counters.refreshes - run->counters.refreshes) * 1000.0 / elapsed,
+        (unsigned long long)(counters.allocations - run->counters.allocations),
+        bench_percentile(run, n, 50), bench_percentile(run, n, 90), bench_percentile(run, n, 99), bench_percentile(run, n, 100));
+    if(run->latencies) allocate(run->latencies, 0);
+}
+
+// engine against itself from the empty board until two passes or one move per point
+static void bench_selfplay(int size, const BENCH_ENGINE *engine) {
+    BOARD *board = (BOARD*)allocate(NULL, sizeof(BOARD));
+    BENCH_RUN run;
+    int moves, passes = 0, x, y, ok;
+    if(!board) return;
+    tt_clear();
+    board_init(board, size, DEFAULT_KOMI);
+    bench_begin(&run, size * size);
+    for(moves = 0; moves < size * size && passes < 2; moves++) {
+        ok = bench_search(&run, board, engine, &x, &y);
+        if(ok < 0) {
+            passes++;
+            board_set_ko(board, -1);
+        } else {
+            passes = 0;
+        }
+        board_set_turn(board, board->turn == BLACK ? WHITE : BLACK);
+    }
+    bench_report(&run, "selfplay", size, engine->name, 1);
+    allocate(board, 0);
+}
+
+// one search on each of the fixed middle game positions
+static void bench_positions(int size, const BENCH_ENGINE *engine) {
+    BOARD *positions = (BOARD*)allocate(NULL, sizeof(BOARD) * BENCH_POSITIONS);
+    BOARD *board = (BOARD*)allocate(NULL, sizeof(BOARD));
+    BENCH_RUN run;
+    int i, x, y;
+    if(!positions || !board) {
+        allocate(positions, 0);
+        allocate(board, 0);
+        return;
+    }
+    for(i = 0; i < BENCH_POSITIONS; i++) bench_position(positions + i, size, size * 2, 1000 + i);
+    tt_clear();
+    bench_begin(&run, BENCH_POSITIONS);
+    for(i = 0; i < BENCH_POSITIONS; i++) {
+        board_copy(board, positions + i);
+        bench_search(&run, board, engine, &x, &y);
+    }
+    bench_report(&run, "positions", size, engine->name, 0);
+    allocate(positions, 0);
+    allocate(board, 0);
+}
+
+// beam search nodes/sec for growing thread counts over the same positions
+static void bench_threads(int size, int max_threads) {
+    BOARD *positions = (BOARD*)allocate(NULL, sizeof(BOARD) * BENCH_POSITIONS);
+    BOARD *board = (BOARD*)allocate(NULL, sizeof(BOARD));
+    SEARCH_STATS stats;
+    double started, elapsed, base = 0.0;
+    uint64_t nodes;
+    int threads, i, x, y;
+    if(!positions || !board) {
+        allocate(positions, 0);
+        allocate(board, 0);
+        return;
+    }
+    for(i = 0; i < BENCH_POSITIONS; i++) bench_position(positions + i, size, size * 2, 1000 + i);
+    for(threads = 1; threads <= max_threads; threads *= 2) {
+        pool_init(threads);
+        tt_clear();
+        nodes = 0;
+        started = stats_now_ms();
+        for(i = 0; i < BENCH_POSITIONS; i++) {
+            board_copy(board, positions + i);
+            board_predict_beam(board, board->turn, NULL, &stats, &x, &y);
+            nodes += stats.nodes;
+        }
+        elapsed = stats_now_ms() - started;
+        if(threads == 1) base = nodes / elapsed;
+        fprintf(stderr, "threads size=%d threads=%d nodes=%llu ms=%.2f nps=%.0f speedup=%.2f\n",
+            size, threads, (unsigned long long)nodes, elapsed, nodes * 1000.0 / elapsed, (nodes / elapsed) / base);
+    }
+    // the other suites search on one thread
+    pool_init(1);
+    allocate(positions, 0);
+    allocate(board, 0);
+}
+
+// alpha-beta nodes and depth when given the time the beam search took on each position
+static void bench_engines(int size) {
+    BOARD *positions = (BOARD*)allocate(NULL, sizeof(BOARD) * BENCH_POSITIONS);
+    BOARD *board = (BOARD*)allocate(NULL, sizeof(BOARD));
+    SEARCH_PARAMS params;
+    SEARCH_STATS stats;
+    uint64_t beam_nodes = 0, ab_nodes = 0;
+    double beam_ms = 0.0, ab_ms = 0.0;
+    int i, x, y, depth = 0;
+    if(!positions || !board) {
+        allocate(positions, 0);
+        allocate(board, 0);
+        return;
+    }
+    for(i = 0; i < BENCH_POSITIONS; i++) bench_position(positions + i, size, size * 2, 1000 + i);
+    for(i = 0; i < BENCH_POSITIONS; i++) {
+        tt_clear();
+        board_copy(board, positions + i);
+        board_predict_beam(board, board->turn, NULL, &stats, &x, &y);
+        beam_nodes += stats.nodes;
+        beam_ms += stats.elapsed_ms;
+
+        tt_clear();
+        params.engine = ENGINE_ALPHABETA;
+        params.playouts = 0;
+        params.nodes = 0;
+        params.abort = NULL;
+        params.time_ms = stats.elapsed_ms < 1.0 ? 1 : (int)(stats.elapsed_ms + 0.5);
+        board_copy(board, positions + i);
+        board_predict_alphabeta(board, board->turn, &params, &stats, &x, &y);
+        ab_nodes += stats.nodes;
+        ab_ms += stats.elapsed_ms;
+        depth += stats.depth;
+    }
+    fprintf(stderr, "engines size=%d beam_nodes=%llu beam_ms=%.2f ab_nodes=%llu ab_ms=%.2f ab_depth=%.1f\n",
+        size, (unsigned long long)beam_nodes, beam_ms, (unsigned long long)ab_nodes, ab_ms, (double)depth / BENCH_POSITIONS);
+    allocate(positions, 0);
+    allocate(board, 0);
+}
+
+// one timed call of a microbenchmark, i counts the calls
+typedef int (*BENCH_CALL)(void *ctx, int i);
+
+// nanoseconds per call over calls calls, the results are summed into checksum
+// so the calls can't be optimized out
+static double bench_time(BENCH_CALL call, void *ctx, int calls, int *checksum) {
+    double started = stats_now_ms();
+    int i, sum = 0;
+    for(i = 0; i < calls; i++) sum += call(ctx, i);
+    if(checksum) *checksum += sum;
+    return (stats_now_ms() - started) * 1e6 / calls;
+}
+
+typedef struct bench_score_ctx {
+    BOARD *positions;
+    int estimate_dead;
+} BENCH_SCORE_CTX;
+
+static int bench_score_call(void *ctx, int i) {
+    BENCH_SCORE_CTX *score = (BENCH_SCORE_CTX*)ctx;
+    return board_score_area(score->positions + i % BENCH_POSITIONS, DEFAULT_KOMI, score->estimate_dead, NULL);
+}
+
+// area count latency on late positions, plain Tromp-Taylor as at playout ends
+// and with the dead group estimate as on passes
+static void bench_score(int size) {
+    BOARD *positions = (BOARD*)allocate(NULL, sizeof(BOARD) * BENCH_POSITIONS);
+    BENCH_SCORE_CTX ctx;
+    AREA_SCORE area;
+    double plain, dead;
+    int i, checksum = 0, opening_dead = 0;
+    if(!positions) return;
+    // stones the estimator takes off seven moves into a 9x9 or larger game,
+    // nothing is enclosed yet, so anything but 0 is a bug
+    for(i = 0; i < BENCH_POSITIONS && size >= 9; i++) {
+        bench_position(positions + i, size, 7, 4000 + i);
+        board_score_area(positions + i, DEFAULT_KOMI, 1, &area);
+        opening_dead += area.dead_black + area.dead_white;
+    }
+    for(i = 0; i < BENCH_POSITIONS; i++) bench_position(positions + i, size, size * size, 3000 + i);
+    ctx.positions = positions;
+    ctx.estimate_dead = 0;
+    plain = bench_time(bench_score_call, &ctx, BENCH_SCORE_CALLS, &checksum);
+    ctx.estimate_dead = 1;
+    dead = bench_time(bench_score_call, &ctx, BENCH_SCORE_CALLS, &checksum);
+    fprintf(stderr, "score size=%d calls=%d ns_per_call=%.1f dead_ns_per_call=%.1f checksum=%d opening_dead=%d\n",
+        size, BENCH_SCORE_CALLS, plain, dead, checksum, opening_dead);
+    allocate(positions, 0);
+}
+
+typedef struct bench_ladder_ctx {
+    BOARD *board;
+    UNDO_STACK *undo;
+    int place;
+} BENCH_LADDER_CTX;
+
+static int bench_ladder_call(void *ctx, int i) {
+    BENCH_LADDER_CTX *ladder = (BENCH_LADDER_CTX*)ctx;
+    int move;
+    return tactics_capture(ladder->board, ladder->undo, NULL, ladder->place, BLACK, &move);
+}
+
+// ladders started on every point of the diagonal, the longest runs across the
+// whole board, each has to be read as captured; latency of uncached readings
+static void bench_ladders(int size) {
+    BENCH_LADDER_CTX ctx;
+    double ns = 0.0;
+    int s, ladders = 0, captured = 0;
+    ctx.board = (BOARD*)allocate(NULL, sizeof(BOARD));
+    ctx.undo = (UNDO_STACK*)allocate(NULL, sizeof(UNDO_STACK));
+    if(!ctx.board || !ctx.undo) {
+        allocate(ctx.board, 0);
+        allocate(ctx.undo, 0);
+        return;
+    }
+    for(s = 1; s + 2 < size; s++) {
+        // the white stone has two liberties and runs towards the far corner
+        board_init(ctx.board, size, DEFAULT_KOMI);
+        board_place(ctx.board, s, s, WHITE);
+        board_place(ctx.board, s - 1, s, BLACK);
+        board_place(ctx.board, s, s - 1, BLACK);
+        board_place(ctx.board, s - 1, s + 1, BLACK);
+        board_undo_init(ctx.undo);
+        ctx.place = s * size + s;
+        ladders++;
+        captured += bench_ladder_call(&ctx, 0);
+        ns += bench_time(bench_ladder_call, &ctx, BENCH_LADDER_READS, NULL);
+    }
+    fprintf(stderr, "ladders size=%d ladders=%d captured=%d ns_per_read=%.1f\n", size, ladders, captured, ladders ? ns / ladders : 0.0);
+    allocate(ctx.board, 0);
+    allocate(ctx.undo, 0);
+}
+
+// bin/gus-bench [max threads] [all | threads | engines | score | ladders | selfplay | positions]
+int main(int argc, const char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8, size, i;
+    const char *suite = argc > 2 ? argv[2] : "all";
+    int all = !strcmp(suite, "all");
+    ai_init();
+    // set up once, every run starts from an empty table
+    pool_init(1);
+    tt_init(16 << 20);
+    if(all || !strcmp(suite, "threads")) {
+        bench_threads(9, max_threads);
+        bench_threads(13, max_threads);
+    }
+    if(all || !strcmp(suite, "engines")) {
+        bench_engines(9);
+        bench_engines(13);
+    }
+    if(all || !strcmp(suite, "score")) {
+        for(size = 0; size < BENCH_SIZES; size++) bench_score(bench_sizes[size]);
+    }
+    if(all || !strcmp(suite, "ladders")) {
+        for(size = 0; size < BENCH_SIZES; size++) bench_ladders(bench_sizes[size]);
+    }
+    for(size = 0; size < BENCH_SIZES; size++) {
+        for(i = 0; i < BENCH_ENGINES; i++) {
+            if(all || !strcmp(suite, "positions")) bench_positions(bench_sizes[size], bench_engine_list + i);
+            if(all || !strcmp(suite, "selfplay")) bench_selfplay(bench_sizes[size], bench_engine_list + i);
+        }
+    }
+    pool_release();
+    tt_release();
+    return 0;
+}
+#endif
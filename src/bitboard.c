@@ -0,0 +1,137 @@
+#include <string.h>
+#include "bitboard.h"
+
+void bit_board_from(BIT_BOARD *out, BOARD *board) {
+    int x, y, n = 0;
+    out->size = board->size;
+    out->stride = board->size + 1;
+    out->turn = board->turn;
+    out->white_score = board->white_score;
+    out->black_score = board->black_score;
+    out->ko = board->ko;
+    bb_clear(out->planes + BLACK);
+    bb_clear(out->planes + WHITE);
+    bb_clear(out->planes + EMPTY);
+    bb_clear(&out->mask);
+    for(y = 0; y < board->size; y++) {
+        for(x = 0; x < board->size; x++, n++) {
+            bb_set(&out->mask, y * out->stride + x);
+            bb_set(out->planes + board->cells[n].color, y * out->stride + x);
+        }
+    }
+}
+
+// writes colors and scores back, group records are rebuilt by the caller
+void bit_board_to(BIT_BOARD *bb, BOARD *out) {
+    int x, y, n = 0, bit;
+    out->turn = bb->turn;
+    out->ko = bb->ko;
+    out->white_score = bb->white_score;
+    out->black_score = bb->black_score;
+    for(y = 0; y < bb->size; y++) {
+        for(x = 0; x < bb->size; x++, n++) {
+            bit = y * bb->stride + x;
+            if(bb_test(bb->planes + BLACK, bit)) out->cells[n].color = BLACK;
+            else if(bb_test(bb->planes + WHITE, bit)) out->cells[n].color = WHITE;
+            else out->cells[n].color = EMPTY;
+        }
+    }
+}
+
+void bit_board_neighbours(BIT_BOARD *bb, BITBOARD *out, const BITBOARD *a) {
+    BITBOARD acc, tmp;
+    bb_shl(&acc, a, 1);
+    bb_shr(&tmp, a, 1);
+    bb_or(&acc, &acc, &tmp);
+    bb_shl(&tmp, a, bb->stride);
+    bb_or(&acc, &acc, &tmp);
+    bb_shr(&tmp, a, bb->stride);
+    bb_or(&acc, &acc, &tmp);
+    bb_and(out, &acc, &bb->mask);
+}
+
+// grows the seed bit inside the plane until it stops changing
+void bit_board_flood(BIT_BOARD *bb, BITBOARD *out, int bit, const BITBOARD *plane) {
+    BITBOARD prev, grown;
+    bb_clear(out);
+    bb_set(out, bit);
+    do {
+        prev = *out;
+        bit_board_neighbours(bb, &grown, out);
+        bb_and(&grown, &grown, plane);
+        bb_or(out, out, &grown);
+    } while(!bb_equal(out, &prev));
+}
+
+int bit_board_liberties(BIT_BOARD *bb, const BITBOARD *group) {
+    BITBOARD around;
+    bit_board_neighbours(bb, &around, group);
+    bb_and(&around, &around, bb->planes + EMPTY);
+    return bb_popcount(&around);
+}
+
+// same rules and return codes as board_place
+int bit_board_place(BIT_BOARD *bb, int x, int y, CELL_COLOR color) {
+    BITBOARD stone, captured, group, left;
+    CELL_COLOR other = color == BLACK ? WHITE : BLACK;
+    int bit, removed;
+    if(x < 0 || y < 0 || x >= bb->size || y >= bb->size) return ERR_OOB;
+    if(y * bb->size + x == bb->ko) return ERR_KO;
+    bit = y * bb->stride + x;
+    if(!bb_test(bb->planes + EMPTY, bit)) return ERR_PLACED;
+
+    bb_clear(&stone);
+    bb_set(&stone, bit);
+    bb_andnot(bb->planes + EMPTY, bb->planes + EMPTY, &stone);
+    bb_or(bb->planes + color, bb->planes + color, &stone);
+
+    bb_clear(&captured);
+    bit_board_neighbours(bb, &left, &stone);
+    bb_and(&left, &left, bb->planes + other);
+    while(!bb_empty(&left)) {
+        bit_board_flood(bb, &group, bb_first(&left), bb->planes + other);
+        bb_andnot(&left, &left, &group);
+        if(bit_board_liberties(bb, &group) == 0) bb_or(&captured, &captured, &group);
+    }
+
+    if(bb_empty(&captured)) {
+        bit_board_flood(bb, &group, bit, bb->planes + color);
+        if(bit_board_liberties(bb, &group) == 0) {
+            bb_andnot(bb->planes + color, bb->planes + color, &stone);
+            bb_or(bb->planes + EMPTY, bb->planes + EMPTY, &stone);
+            return ERR_SUICIDE;
+        }
+        bb->ko = -1;
+        return 0;
+    }
+
+    removed = bb_popcount(&captured);
+    bb_andnot(bb->planes + other, bb->planes + other, &captured);
+    bb_or(bb->planes + EMPTY, bb->planes + EMPTY, &captured);
+    if(color == BLACK) bb->black_score += 10 * removed;
+    else bb->white_score += 10 * removed;
+    if(removed == 1) {
+        bit = bb_first(&captured);
+        bb->ko = (bit / bb->stride) * bb->size + bit % bb->stride;
+    } else {
+        bb->ko = -1;
+    }
+    return removed;
+}
+
+void bit_board_stats(BIT_BOARD *bb, BIT_STATS *stats) {
+    BITBOARD left, group;
+    int color;
+    for(color = BLACK; color <= WHITE; color++) {
+        left = bb->planes[color];
+        stats->stones[color] = bb_popcount(&left);
+        stats->groups[color] = 0;
+        stats->liberties[color] = 0;
+        while(!bb_empty(&left)) {
+            bit_board_flood(bb, &group, bb_first(&left), &left);
+            bb_andnot(&left, &left, &group);
+            stats->groups[color]++;
+            stats->liberties[color] += bit_board_liberties(bb, &group);
+        }
+    }
+}
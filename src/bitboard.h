@@ -0,0 +1,162 @@
+#ifndef __S80_GUS_BITBOARD__
+#define __S80_GUS_BITBOARD__
+#include "ai.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// rows are padded with one guard column (stride = size + 1), so horizontal
+// shifts never wrap into the next row once masked by the on-board plane
+#define BB_STRIDE (MAX_BOARD + 1)
+#define BB_BITS (BB_STRIDE * MAX_BOARD)
+#define BB_WORDS ((((BB_BITS + 63) / 64) + 3) & ~3)
+
+typedef union bitboard {
+    uint64_t w[BB_WORDS];
+#ifdef __AVX2__
+    __m256i v[BB_WORDS / 4];
+#endif
+} BITBOARD;
+
+typedef struct bit_board {
+    BITBOARD planes[3]; // indexed by CELL_COLOR
+    BITBOARD mask;
+    char size;
+    char stride;
+    char turn;
+    short ko;
+    short white_score;
+    short black_score;
+} BIT_BOARD;
+
+typedef struct bit_stats {
+    short stones[2];
+    short groups[2];
+    short liberties[2];
+} BIT_STATS;
+
+static inline void bb_clear(BITBOARD *a) {
+    int i;
+    for(i = 0; i < BB_WORDS; i++) a->w[i] = 0;
+}
+
+static inline void bb_set(BITBOARD *a, int bit) {
+    a->w[bit >> 6] |= 1ULL << (bit & 63);
+}
+
+static inline int bb_test(const BITBOARD *a, int bit) {
+    return (a->w[bit >> 6] >> (bit & 63)) & 1;
+}
+
+static inline int bb_empty(const BITBOARD *a) {
+    uint64_t acc = 0;
+    int i;
+    for(i = 0; i < BB_WORDS; i++) acc |= a->w[i];
+    return acc == 0;
+}
+
+static inline int bb_equal(const BITBOARD *a, const BITBOARD *b) {
+    uint64_t acc = 0;
+    int i;
+    for(i = 0; i < BB_WORDS; i++) acc |= a->w[i] ^ b->w[i];
+    return acc == 0;
+}
+
+static inline int bb_popcount(const BITBOARD *a) {
+    int i, n = 0;
+    for(i = 0; i < BB_WORDS; i++) n += __builtin_popcountll(a->w[i]);
+    return n;
+}
+
+// index of lowest set bit, -1 if empty
+static inline int bb_first(const BITBOARD *a) {
+    int i;
+    for(i = 0; i < BB_WORDS; i++) {
+        if(a->w[i]) return (i << 6) + __builtin_ctzll(a->w[i]);
+    }
+    return -1;
+}
+
+#ifdef __AVX2__
+static inline void bb_and(BITBOARD *out, const BITBOARD *a, const BITBOARD *b) {
+    int i;
+    for(i = 0; i < BB_WORDS / 4; i++) out->v[i] = _mm256_and_si256(a->v[i], b->v[i]);
+}
+
+static inline void bb_or(BITBOARD *out, const BITBOARD *a, const BITBOARD *b) {
+    int i;
+    for(i = 0; i < BB_WORDS / 4; i++) out->v[i] = _mm256_or_si256(a->v[i], b->v[i]);
+}
+
+// out = a & ~b
+static inline void bb_andnot(BITBOARD *out, const BITBOARD *a, const BITBOARD *b) {
+    int i;
+    for(i = 0; i < BB_WORDS / 4; i++) out->v[i] = _mm256_andnot_si256(b->v[i], a->v[i]);
+}
+
+// whole-board shifts by 0 < k < 64, lanes carry into their neighbour lane and
+// the last lane of one register carries into the first lane of the next one
+static inline void bb_shl(BITBOARD *out, const BITBOARD *a, int k) {
+    __m128i cnt = _mm_cvtsi32_si128(k), rcnt = _mm_cvtsi32_si128(64 - k);
+    __m256i carry_in = _mm256_setzero_si256(), lo, hi;
+    int i;
+    for(i = 0; i < BB_WORDS / 4; i++) {
+        lo = _mm256_sll_epi64(a->v[i], cnt);
+        hi = _mm256_srl_epi64(a->v[i], rcnt);
+        hi = _mm256_permute4x64_epi64(hi, _MM_SHUFFLE(2, 1, 0, 3));
+        out->v[i] = _mm256_or_si256(lo, _mm256_blend_epi32(hi, carry_in, 0x03));
+        carry_in = _mm256_blend_epi32(_mm256_setzero_si256(), hi, 0x03);
+    }
+}
+
+static inline void bb_shr(BITBOARD *out, const BITBOARD *a, int k) {
+    __m128i cnt = _mm_cvtsi32_si128(k), rcnt = _mm_cvtsi32_si128(64 - k);
+    __m256i carry_in = _mm256_setzero_si256(), lo, hi;
+    int i;
+    for(i = BB_WORDS / 4 - 1; i >= 0; i--) {
+        hi = _mm256_srl_epi64(a->v[i], cnt);
+        lo = _mm256_sll_epi64(a->v[i], rcnt);
+        lo = _mm256_permute4x64_epi64(lo, _MM_SHUFFLE(0, 3, 2, 1));
+        out->v[i] = _mm256_or_si256(hi, _mm256_blend_epi32(lo, carry_in, 0xC0));
+        carry_in = _mm256_blend_epi32(_mm256_setzero_si256(), lo, 0xC0);
+    }
+}
+#else
+static inline void bb_and(BITBOARD *out, const BITBOARD *a, const BITBOARD *b) {
+    int i;
+    for(i = 0; i < BB_WORDS; i++) out->w[i] = a->w[i] & b->w[i];
+}
+
+static inline void bb_or(BITBOARD *out, const BITBOARD *a, const BITBOARD *b) {
+    int i;
+    for(i = 0; i < BB_WORDS; i++) out->w[i] = a->w[i] | b->w[i];
+}
+
+// out = a & ~b
+static inline void bb_andnot(BITBOARD *out, const BITBOARD *a, const BITBOARD *b) {
+    int i;
+    for(i = 0; i < BB_WORDS; i++) out->w[i] = a->w[i] & ~b->w[i];
+}
+
+// whole-board shifts by 0 < k < 64
+static inline void bb_shl(BITBOARD *out, const BITBOARD *a, int k) {
+    int i;
+    for(i = BB_WORDS - 1; i > 0; i--) out->w[i] = (a->w[i] << k) | (a->w[i - 1] >> (64 - k));
+    out->w[0] = a->w[0] << k;
+}
+
+static inline void bb_shr(BITBOARD *out, const BITBOARD *a, int k) {
+    int i;
+    for(i = 0; i < BB_WORDS - 1; i++) out->w[i] = (a->w[i] >> k) | (a->w[i + 1] << (64 - k));
+    out->w[BB_WORDS - 1] = a->w[BB_WORDS - 1] >> k;
+}
+#endif
+
+void bit_board_from(BIT_BOARD *out, BOARD *board);
+void bit_board_to(BIT_BOARD *bb, BOARD *out);
+void bit_board_neighbours(BIT_BOARD *bb, BITBOARD *out, const BITBOARD *a);
+void bit_board_flood(BIT_BOARD *bb, BITBOARD *out, int bit, const BITBOARD *plane);
+int  bit_board_liberties(BIT_BOARD *bb, const BITBOARD *group);
+int  bit_board_place(BIT_BOARD *bb, int x, int y, CELL_COLOR color);
+void bit_board_stats(BIT_BOARD *bb, BIT_STATS *stats);
+#endif
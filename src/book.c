@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "ai.h"
+#include "book.h"
+
+static BOOK_HEADER *header = NULL;
+static BOOK_ENTRY *entries = NULL;
+static size_t mapped = 0;
+
+// maps the book read-only, a book of another format or built by another
+// evaluation or komi is refused, so stale books never override the search
+int book_open(const char *path) {
+#ifdef _WIN32
+    return -1;
+#else
+    struct stat st;
+    void *mem;
+    int fd;
+    book_close();
+    fd = open(path, O_RDONLY);
+    if(fd < 0) return -1;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(BOOK_HEADER)) {
+        close(fd);
+        return -1;
+    }
+    mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) return -1;
+    header = (BOOK_HEADER*)mem;
+    if(header->magic != BOOK_MAGIC || header->version != BOOK_VERSION
+    || header->eval != ai_eval_fingerprint() || header->komi != DEFAULT_KOMI
+    || sizeof(BOOK_HEADER) + (size_t)header->entries * sizeof(BOOK_ENTRY) > (size_t)st.st_size) {
+        munmap(mem, st.st_size);
+        header = NULL;
+        return -1;
+    }
+    entries = (BOOK_ENTRY*)(header + 1);
+    mapped = st.st_size;
+    return 0;
+#endif
+}
+
+void book_close() {
+#ifndef _WIN32
+    if(header) munmap(header, mapped);
+#endif
+    header = NULL;
+    entries = NULL;
+    mapped = 0;
+}
+
+// binary search over the sorted keys
+int book_probe(uint64_t key, int *move, int *depth) {
+    size_t lo = 0, hi, mid;
+    if(!header) return 0;
+    hi = header->entries;
+    while(lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if(entries[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    if(lo == header->entries || entries[lo].key != key) return 0;
+    *move = entries[lo].move;
+    *depth = entries[lo].depth;
+    return 1;
+}
+
+static int book_compare(const void *a, const void *b) {
+    uint64_t ka = ((const BOOK_ENTRY*)a)->key, kb = ((const BOOK_ENTRY*)b)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+// sorts the entries in place and writes them behind a header for the current
+// evaluation, duplicate keys keep the deepest entry
+int book_write(const char *path, BOOK_ENTRY *list, size_t n) {
+    BOOK_HEADER out;
+    size_t i, kept = 0;
+    FILE *f;
+    qsort(list, n, sizeof(BOOK_ENTRY), book_compare);
+    for(i = 0; i < n; i++) {
+        if(kept > 0 && list[kept - 1].key == list[i].key) {
+            if(list[i].depth > list[kept - 1].depth) list[kept - 1] = list[i];
+            continue;
+        }
+        list[kept++] = list[i];
+    }
+    memset(&out, 0, sizeof(out));
+    out.magic = BOOK_MAGIC;
+    out.version = BOOK_VERSION;
+    out.entries = kept;
+    out.eval = ai_eval_fingerprint();
+    out.komi = DEFAULT_KOMI;
+    f = fopen(path, "wb");
+    if(!f) return -1;
+    if(fwrite(&out, sizeof(out), 1, f) != 1 || (kept && fwrite(list, sizeof(BOOK_ENTRY), kept, f) != kept)) {
+        fclose(f);
+        return -1;
+    }
+    return fclose(f) == 0 ? (int)kept : -1;
+}
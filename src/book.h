@@ -0,0 +1,33 @@
+#ifndef __S80_GUS_BOOK__
+#define __S80_GUS_BOOK__
+#include <stdlib.h>
+#include <stdint.h>
+
+#define BOOK_MAGIC 0x4B4F4F42535547ULL     // "GUSBOOK"
+#define BOOK_VERSION 2
+
+// file layout: header followed by entries sorted by key
+typedef struct book_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t entries;
+    uint64_t eval;      // ai_eval_fingerprint() of the evaluation that built it
+    int32_t komi;       // in tenths of a point, replies for another komi don't apply
+    uint32_t reserved;
+} BOOK_HEADER;
+
+// reply for one canonical position with side to move, the move is stored
+// in canonical orientation, -1 for a pass
+typedef struct book_entry {
+    uint64_t key;
+    short move;
+    unsigned char depth;
+    unsigned char size;
+    int reserved;
+} BOOK_ENTRY;
+
+int  book_open(const char *path);
+void book_close();
+int  book_probe(uint64_t key, int *move, int *depth);
+int  book_write(const char *path, BOOK_ENTRY *entries, size_t n);
+#endif
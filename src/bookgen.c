@@ -0,0 +1,153 @@
+#ifdef GUS_BOOKGEN
+#include <stdio.h>
+#include <string.h>
+#include "ai.h"
+#include "tt.h"
+#include "pool.h"
+#include "book.h"
+#include "pattern.h"
+
+// offline opening book generator: every position the engine can face within
+// the first opponent moves from the empty board gets a deep search reply
+typedef struct book_builder {
+    BOOK_ENTRY *entries;
+    size_t n;
+    size_t capacity;
+    uint64_t *seen;     // open addressed keys of the searched positions, 0 is a free slot
+    size_t seen_mask;
+    size_t n_seen;
+    int seen_zero;
+    SEARCH_PARAMS params;
+    uint64_t searched_nodes;
+} BOOK_BUILDER;
+
+static void book_seen_put(uint64_t *seen, size_t mask, uint64_t key) {
+    size_t i = (size_t)(key * 0x9E3779B97F4A7C15ULL) & mask;
+    while(seen[i] && seen[i] != key) i = (i + 1) & mask;
+    seen[i] = key;
+}
+
+// marks the position as searched, returns 1 if it already was and -1 on errors
+static int book_seen(BOOK_BUILDER *builder, uint64_t key) {
+    uint64_t *seen;
+    size_t i, mask;
+    if(!key) {
+        if(builder->seen_zero) return 1;
+        builder->seen_zero = 1;
+        return 0;
+    }
+    if(builder->seen) {
+        i = (size_t)(key * 0x9E3779B97F4A7C15ULL) & builder->seen_mask;
+        while(builder->seen[i]) {
+            if(builder->seen[i] == key) return 1;
+            i = (i + 1) & builder->seen_mask;
+        }
+    }
+    // kept at most half full
+    if(!builder->seen || (builder->n_seen + 1) * 2 > builder->seen_mask + 1) {
+        mask = builder->seen ? builder->seen_mask * 2 + 1 : 1023;
+        seen = (uint64_t*)allocate(NULL, sizeof(uint64_t) * (mask + 1));
+        if(!seen) return -1;
+        memset(seen, 0, sizeof(uint64_t) * (mask + 1));
+        for(i = 0; builder->seen && i <= builder->seen_mask; i++) {
+            if(builder->seen[i]) book_seen_put(seen, mask, builder->seen[i]);
+        }
+        if(builder->seen) allocate(builder->seen, 0);
+        builder->seen = seen;
+        builder->seen_mask = mask;
+    }
+    book_seen_put(builder->seen, builder->seen_mask, key);
+    builder->n_seen++;
+    return 0;
+}
+
+static int book_add(BOOK_BUILDER *builder, BOOK_ENTRY *entry) {
+    BOOK_ENTRY *entries;
+    if(builder->n == builder->capacity) {
+        entries = (BOOK_ENTRY*)allocate(builder->entries, sizeof(BOOK_ENTRY) * (builder->capacity * 2 + 64));
+        if(!entries) return -1;
+        builder->entries = entries;
+        builder->capacity = builder->capacity * 2 + 64;
+    }
+    builder->entries[builder->n++] = *entry;
+    return 0;
+}
+
+static void book_answers(BOOK_BUILDER *builder, BOARD *board, int moves);
+
+// engine to move: searches the position once, then follows its reply
+static void book_reply(BOOK_BUILDER *builder, BOARD *board, int moves) {
+    BOARD next;
+    BOOK_ENTRY entry;
+    SEARCH_STATS stats;
+    int symmetry_index, ok, x, y;
+    memset(&entry, 0, sizeof(entry));
+    symmetry_index = board_canonical(board, &entry.key);
+    if(book_seen(builder, entry.key) != 0) return;
+    board_copy(&next, board);
+    ok = board_search(&next, next.turn, &builder->params, &stats, &x, &y);
+    if(ok < 0 && ok != ERR_PASS) return;
+    entry.move = ok == ERR_PASS ? -1 : board_to_canonical(board, symmetry_index, y * board->size + x);
+    entry.depth = stats.depth;
+    entry.size = board->size;
+    if(book_add(builder, &entry) < 0) return;
+    builder->searched_nodes += stats.nodes;
+    if(builder->n % 100 == 0) fprintf(stderr, "book: %zu positions\n", builder->n);
+    if(moves <= 0) return;
+    if(ok == ERR_PASS) board_set_ko(&next, -1);
+    board_set_turn(&next, next.turn == BLACK ? WHITE : BLACK);
+    book_answers(builder, &next, moves);
+}
+
+// opponent to move: every legal move leads to a position the engine faces
+static void book_answers(BOOK_BUILDER *builder, BOARD *board, int moves) {
+    BOARD next;
+    int p;
+    for(p = 0; p < board->square; p++) {
+        board_copy(&next, board);
+        if(board_place(&next, p % board->size, p / board->size, next.turn) < 0) continue;
+        board_set_turn(&next, next.turn == BLACK ? WHITE : BLACK);
+        book_reply(builder, &next, moves - 1);
+    }
+}
+
+int main(int argc, const char **argv) {
+    BOOK_BUILDER builder;
+    BOARD board;
+    int size = argc > 2 ? atoi(argv[2]) : 9, moves = argc > 3 ? atoi(argv[3]) : 2, written;
+    if(argc < 2 || size < 1 || size > MAX_BOARD || moves < 1) {
+        fprintf(stderr, "usage: %s <book> [size = 9] [opponent moves = 2] [time_ms = 200] [weights] [patterns]\n", argv[0]);
+        return 1;
+    }
+    ai_init();
+    if(argc > 5 && ai_load_weights(argv[5]) < 0) {
+        fprintf(stderr, "book: failed to load weights from %s\n", argv[5]);
+        return 1;
+    }
+    if(argc > 6 && pattern_load(argv[6]) < 0) {
+        fprintf(stderr, "book: failed to load patterns from %s\n", argv[6]);
+        return 1;
+    }
+    tt_init(64 << 20);
+    pool_init(1);
+    memset(&builder, 0, sizeof(builder));
+    builder.params.engine = ENGINE_ALPHABETA;
+    builder.params.time_ms = argc > 4 ? atoi(argv[4]) : 200;
+
+    board_init(&board, size, DEFAULT_KOMI);
+    book_reply(&builder, &board, 0);
+    book_answers(&builder, &board, moves);
+
+    written = book_write(argv[1], builder.entries, builder.n);
+    if(written < 0) {
+        fprintf(stderr, "book: failed to write %s\n", argv[1]);
+    } else {
+        fprintf(stderr, "book: size=%d positions=%d nodes=%llu\n", size, written, (unsigned long long)builder.searched_nodes);
+    }
+    if(builder.entries) allocate(builder.entries, 0);
+    if(builder.seen) allocate(builder.seen, 0);
+    pool_release();
+    tt_release();
+    return written < 0;
+}
+#endif
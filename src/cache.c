@@ -0,0 +1,225 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "ai.h"
+#include "cache.h"
+
+#define CACHE_MAGIC 0x4755534341434845ULL
+#define CACHE_VERSION 4
+#define CACHE_READY 2
+
+// the segment starts with this header followed by the buckets, every worker
+// process maps the same named segment, so its locks are process shared mutexes
+// that stay usable when a worker dies holding one
+typedef struct cache_header {
+    uint64_t magic;
+    int version;
+    int entry_size;     // sizeof(CACHE_ENTRY)
+    int max_board;
+    uint64_t eval;      // ai_eval_fingerprint() of the evaluation the replies come from
+    int komi;           // in tenths of a point, the replies depend on it
+    uint64_t bytes;     // GUS_CACHE_MB budget the segment was laid out for
+    uint64_t n_buckets;
+    int state;          // 0 fresh, 1 being initialized, CACHE_READY
+    pthread_mutex_t locks[CACHE_STRIPES];
+    unsigned char hands[CACHE_STRIPES];
+    CACHE_STATS stats;
+} CACHE_HEADER;
+
+static CACHE_HEADER *header = NULL;
+static CACHE_BUCKET *buckets = NULL;
+static size_t mapped = 0;
+
+static void cache_lock(int stripe) {
+#ifndef _WIN32
+    uint64_t i;
+    if(pthread_mutex_lock(header->locks + stripe) == EOWNERDEAD) {
+        // the owner died mid write, its stripe's buckets can't be trusted
+        for(i = stripe; i < header->n_buckets; i += CACHE_STRIPES) memset(buckets + i, 0, sizeof(CACHE_BUCKET));
+        pthread_mutex_consistent(header->locks + stripe);
+    }
+#endif
+}
+
+static void cache_unlock(int stripe) {
+#ifndef _WIN32
+    pthread_mutex_unlock(header->locks + stripe);
+#endif
+}
+
+#ifndef _WIN32
+// whether a ready segment was laid out by this build for this evaluation, komi and budget
+static int cache_current(size_t size, size_t bytes) {
+    return header->magic == CACHE_MAGIC && header->version == CACHE_VERSION
+        && header->entry_size == (int)sizeof(CACHE_ENTRY) && header->max_board == MAX_BOARD
+        && header->eval == ai_eval_fingerprint() && header->komi == DEFAULT_KOMI && header->bytes == bytes
+        && sizeof(CACHE_HEADER) + header->n_buckets * sizeof(CACHE_BUCKET) <= size;
+}
+
+// returns 0 once mapped, 1 for a segment left by another build, evaluation or
+// budget, whose inode is written to stale, and -1 on errors
+static int cache_map(const char *name, size_t bytes, ino_t *stale) {
+    struct stat st;
+    size_t size;
+    uint64_t n = 1;
+    int i, fd, expected = 0;
+    pthread_mutexattr_t attr;
+    void *mem;
+    while(sizeof(CACHE_HEADER) + n * 2 * sizeof(CACHE_BUCKET) <= bytes) n *= 2;
+    fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if(fd < 0) return -1;
+    if(fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    size = st.st_size;
+    if(size == 0) {
+        size = sizeof(CACHE_HEADER) + n * sizeof(CACHE_BUCKET);
+        if(ftruncate(fd, size) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    // too small for this header, so an older layout
+    if(size < sizeof(CACHE_HEADER)) {
+        close(fd);
+        *stale = st.st_ino;
+        return 1;
+    }
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) return -1;
+    header = (CACHE_HEADER*)mem;
+    if(__atomic_compare_exchange_n(&header->state, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // a fresh segment is zero filled, only the layout is left to write
+        header->magic = CACHE_MAGIC;
+        header->version = CACHE_VERSION;
+        header->entry_size = sizeof(CACHE_ENTRY);
+        header->max_board = MAX_BOARD;
+        header->eval = ai_eval_fingerprint();
+        header->komi = DEFAULT_KOMI;
+        header->bytes = bytes;
+        header->n_buckets = (size - sizeof(CACHE_HEADER)) / sizeof(CACHE_BUCKET);
+        header->stats.buckets = header->n_buckets;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        for(i = 0; i < CACHE_STRIPES; i++) pthread_mutex_init(header->locks + i, &attr);
+        pthread_mutexattr_destroy(&attr);
+        __atomic_store_n(&header->state, CACHE_READY, __ATOMIC_RELEASE);
+    }
+    while(__atomic_load_n(&header->state, __ATOMIC_ACQUIRE) != CACHE_READY) usleep(100);
+    if(!cache_current(size, bytes)) {
+        munmap(mem, size);
+        header = NULL;
+        *stale = st.st_ino;
+        return 1;
+    }
+    buckets = (CACHE_BUCKET*)(header + 1);
+    mapped = size;
+    return 0;
+}
+#endif
+
+// maps the named shared memory segment, the first process to get there lays it
+// out and the others wait for it; a segment left by another build, evaluation
+// or budget is unlinked and laid out again, workers still mapping it keep
+// their copy until they reload
+int cache_init(const char *name, size_t bytes) {
+#ifdef _WIN32
+    return -1;
+#else
+    struct stat st;
+    ino_t stale;
+    int fd, attempt, ok = -1;
+    cache_release();
+    if(bytes < sizeof(CACHE_HEADER) + sizeof(CACHE_BUCKET)) return -1;
+    for(attempt = 0; attempt < 2; attempt++) {
+        ok = cache_map(name, bytes, &stale);
+        if(ok <= 0) break;
+        // another worker may have replaced the stale segment already
+        fd = shm_open(name, O_RDWR, 0600);
+        if(fd >= 0) {
+            if(fstat(fd, &st) == 0 && st.st_ino == stale) shm_unlink(name);
+            close(fd);
+        }
+    }
+    return ok == 0 ? 0 : -1;
+#endif
+}
+
+// unmaps only, the segment outlives the worker for the others and for reloads
+void cache_release() {
+#ifndef _WIN32
+    if(header) munmap(header, mapped);
+#endif
+    header = NULL;
+    buckets = NULL;
+    mapped = 0;
+}
+
+int cache_probe(uint64_t key, int *move, int *depth) {
+    CACHE_BUCKET *bucket;
+    int i, stripe, hit = 0;
+    if(!header || !key) return 0;
+    bucket = buckets + key % header->n_buckets;
+    stripe = (key % header->n_buckets) % CACHE_STRIPES;
+    __atomic_fetch_add(&header->stats.probes, 1, __ATOMIC_RELAXED);
+    cache_lock(stripe);
+    for(i = 0; i < CACHE_WAYS; i++) {
+        if(bucket->ways[i].key == key) {
+            bucket->ways[i].referenced = 1;
+            *move = bucket->ways[i].move;
+            *depth = bucket->ways[i].depth;
+            hit = 1;
+            break;
+        }
+    }
+    cache_unlock(stripe);
+    if(hit) __atomic_fetch_add(&header->stats.hits, 1, __ATOMIC_RELAXED);
+    return hit;
+}
+
+// replaces the same key, then a free way, then the first way the clock hand
+// finds unreferenced since it last passed
+void cache_store(uint64_t key, int move, int depth) {
+    CACHE_BUCKET *bucket;
+    CACHE_ENTRY *entry = NULL;
+    int i, stripe;
+    if(!header || !key) return;
+    bucket = buckets + key % header->n_buckets;
+    stripe = (key % header->n_buckets) % CACHE_STRIPES;
+    cache_lock(stripe);
+    for(i = 0; i < CACHE_WAYS && !entry; i++) {
+        if(bucket->ways[i].key == key) entry = bucket->ways + i;
+    }
+    for(i = 0; i < CACHE_WAYS && !entry; i++) {
+        if(bucket->ways[i].key == 0) entry = bucket->ways + i;
+    }
+    while(!entry) {
+        i = header->hands[stripe]++ % CACHE_WAYS;
+        if(bucket->ways[i].referenced) bucket->ways[i].referenced = 0;
+        else entry = bucket->ways + i;
+    }
+    if(entry->key && entry->key != key) __atomic_fetch_add(&header->stats.evictions, 1, __ATOMIC_RELAXED);
+    entry->key = key;
+    entry->move = move;
+    entry->depth = depth > 255 ? 255 : depth;
+    entry->referenced = 0;
+    cache_unlock(stripe);
+    __atomic_fetch_add(&header->stats.stores, 1, __ATOMIC_RELAXED);
+}
+
+void cache_stats(CACHE_STATS *out) {
+    if(!header) {
+        memset(out, 0, sizeof(CACHE_STATS));
+        return;
+    }
+    memcpy(out, &header->stats, sizeof(CACHE_STATS));
+}
@@ -0,0 +1,36 @@
+#ifndef __S80_GUS_CACHE__
+#define __S80_GUS_CACHE__
+#include <stdlib.h>
+#include <stdint.h>
+
+#define CACHE_WAYS 4
+#define CACHE_STRIPES 256
+
+// search result for one position, side to move and search setting
+typedef struct cache_entry {
+    uint64_t key;
+    short move;         // board index, -1 for a pass
+    unsigned char depth;
+    unsigned char referenced;
+    int reserved;
+} CACHE_ENTRY;
+
+// one cache line of ways, the clock hands are kept per lock stripe
+typedef struct cache_bucket {
+    CACHE_ENTRY ways[CACHE_WAYS];
+} CACHE_BUCKET;
+
+typedef struct cache_stats {
+    uint64_t buckets;
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t stores;
+    uint64_t evictions;
+} CACHE_STATS;
+
+int  cache_init(const char *name, size_t bytes);
+void cache_release();
+int  cache_probe(uint64_t key, int *move, int *depth);
+void cache_store(uint64_t key, int move, int depth);
+void cache_stats(CACHE_STATS *out);
+#endif
@@ -1,10 +1,26 @@
+#include <stdio.h>
+#include <string.h>
 #include "ai.h"
+#include "tt.h"
+#include "pool.h"
+#include "async.h"
+#include "arena.h"
+#include "cache.h"
+#include "book.h"
+#include "stats.h"
+#include "ponder.h"
+#include "pattern.h"
+#include "score.h"
 
 #ifndef GUS_EXE
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
 #include "../../src/80s.h"
+#include <stdint.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 #endif
 
 #ifdef _WIN32
@@ -18,12 +34,14 @@ void *allocate(void *mem, size_t size) {
         free(mem);
         mem = NULL;
     } else {
+        STAT_ADD(allocations, 1);
         mem = realloc(mem, size);
     }
     return mem;
 }
 
 #ifdef GUS_EXE
+#if !defined(GUS_BENCH) && !defined(GUS_BOOKGEN) && !defined(GUS_PERFT)
 // Ko: 2 2 3 2 1 3 4 3 3 3 3 4 2 4 2 3 3 3
 // Suicide 1: 2 2 5 5 1 3 5 6 3 3 5 7 2 4
 // Suicide 2: 1 3 1 9 2 2 2 9 3 2 3 9 2 4 4 9 3 4 3 3 4 3 3 3
@@ -31,7 +49,7 @@ void *allocate(void *mem, size_t size) {
 int main() {
     int x, y, n = 0;
     BOARD board;
-    board_init(&board, 9, 65);
+    board_init(&board, 9, DEFAULT_KOMI);
     for(;;) {
         printf("It's %s's turn!\n\n", board.turn == BLACK ? "black" : "white");
         board_print(&board);
@@ -64,11 +82,51 @@ int main() {
                 printf("Removed %d stones!\n", n);
             }
         } while(n < 0);
-        board.turn = board.turn == BLACK ? WHITE : BLACK;
+        board_set_turn(&board, board.turn == BLACK ? WHITE : BLACK);
     }
 }
+#endif
 #else
 
+// reads optional { engine = "beam" | "mcts" | "alphabeta", playouts = int, time_ms = int, nodes = int } table
+static void l_gus_search_params(lua_State *L, int index, SEARCH_PARAMS *params) {
+    const char *engine;
+    params->engine = ENGINE_BEAM;
+    params->playouts = 0;
+    params->time_ms = 0;
+    params->nodes = 0;
+    params->abort = NULL;
+    if(lua_gettop(L) < index || lua_type(L, index) != LUA_TTABLE) return;
+    lua_getfield(L, index, "engine");
+    engine = lua_type(L, -1) == LUA_TSTRING ? lua_tostring(L, -1) : NULL;
+    if(engine && !strcmp(engine, "mcts")) params->engine = ENGINE_MCTS;
+    else if(engine && !strcmp(engine, "alphabeta")) params->engine = ENGINE_ALPHABETA;
+    lua_pop(L, 1);
+    lua_getfield(L, index, "playouts");
+    if(lua_type(L, -1) == LUA_TNUMBER) params->playouts = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    lua_getfield(L, index, "time_ms");
+    if(lua_type(L, -1) == LUA_TNUMBER) params->time_ms = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    lua_getfield(L, index, "nodes");
+    if(lua_type(L, -1) == LUA_TNUMBER) params->nodes = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+}
+
+static int l_gus_push_result(lua_State *L, int ok, int x, int y, SEARCH_STATS *stats) {
+    lua_pushinteger(L, ok);
+    lua_pushinteger(L, x);
+    lua_pushinteger(L, y);
+    lua_newtable(L);
+    lua_pushinteger(L, (lua_Integer)stats->nodes);
+    lua_setfield(L, -2, "nodes");
+    lua_pushinteger(L, stats->depth);
+    lua_setfield(L, -2, "depth");
+    lua_pushnumber(L, stats->elapsed_ms);
+    lua_setfield(L, -2, "elapsed_ms");
+    return 4;
+}
+
 static int l_gus_place(lua_State *L) {
     if(lua_gettop(L) < 3 
     || lua_type(L, 1) != LUA_TLIGHTUSERDATA 
@@ -76,33 +134,134 @@ static int l_gus_place(lua_State *L) {
     || lua_type(L, 3) != LUA_TNUMBER 
     || lua_type(L, 4) != LUA_TBOOLEAN 
     || lua_type(L, 5) != LUA_TBOOLEAN) {
-        return luaL_error(L, "expecting 3 arguments: board (lightuserdata), x (int), y (int), predict (bool), pass (bool)");
+        return luaL_error(L, "expecting 3 arguments: board (lightuserdata), x (int), y (int), predict (bool), pass (bool), [search (table)]");
     }
     BOARD *board = (BOARD*)lua_touserdata(L, 1);
     int x = lua_tointeger(L, 2);
     int y = lua_tointeger(L, 3);
     int predict = lua_toboolean(L, 4);
     int pass = lua_toboolean(L, 5);
-    int ok = 0;
-    if(!pass) {
-        ok = board_place(board, x, y, board->turn);
+    int ok;
+    double started = stats_now_ms();
+    SEARCH_PARAMS search;
+    SEARCH_STATS stats = {0};
+    l_gus_search_params(L, 6, &search);
+    // the pondering shares the threads and the table, it has done its part by now
+    ponder_stop();
+    ok = board_play(board, &x, &y, predict, pass, &search, &stats);
+    STAT_TIME(PHASE_PLACE, started);
+    return l_gus_push_result(L, ok, x, y, &stats);
+}
+
+typedef struct l_gus_job {
+    BOARD *board;
+    int x;
+    int y;
+    int predict;
+    int pass;
+    int ok;
+    SEARCH_PARAMS search;
+    SEARCH_STATS stats;
+} L_GUS_JOB;
+
+static void l_gus_run_job(void *ctx) {
+    L_GUS_JOB *job = (L_GUS_JOB*)ctx;
+    double started = stats_now_ms();
+    job->ok = board_play(job->board, &job->x, &job->y, job->predict, job->pass, &job->search, &job->stats);
+    STAT_TIME(PHASE_PLACE, started);
+}
+
+// adds the completion fd to the worker's event loop the way 80s adds its pipes,
+// the loop reads it once the job is done and passes it to on_data like any other fd
+static int l_gus_watch(int elfd, int fd) {
+#ifdef __linux__
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+#ifdef SET_FD_HOLDER
+    SET_FD_HOLDER(&ev.data, S80_FD_PIPE, fd);
+#else
+    ev.data.fd = fd;
+#endif
+    return epoll_ctl(elfd, EPOLL_CTL_ADD, fd, &ev);
+#else
+    return -1;
+#endif
+}
+
+// same as place with the worker's event loop in front, returns a handle and
+// the fd the loop reports readable once the result can be collected, the fd is
+// nil if the loop can't watch it, nothing is returned when no job can be queued
+// and the board must stay alive until the handle is collected
+static int l_gus_place_async(lua_State *L) {
+    L_GUS_JOB *job;
+    ASYNC_JOB *handle;
+    if(lua_gettop(L) < 6
+    || lua_type(L, 1) != LUA_TLIGHTUSERDATA
+    || lua_type(L, 2) != LUA_TLIGHTUSERDATA
+    || lua_type(L, 3) != LUA_TNUMBER
+    || lua_type(L, 4) != LUA_TNUMBER
+    || lua_type(L, 5) != LUA_TBOOLEAN
+    || lua_type(L, 6) != LUA_TBOOLEAN) {
+        return luaL_error(L, "expecting 6 arguments: elfd (lightuserdata), board (lightuserdata), x (int), y (int), predict (bool), pass (bool), [search (table)]");
+    }
+    job = (L_GUS_JOB*)allocate(NULL, sizeof(L_GUS_JOB));
+    if(!job) return 0;
+    job->board = (BOARD*)lua_touserdata(L, 2);
+    job->x = lua_tointeger(L, 3);
+    job->y = lua_tointeger(L, 4);
+    job->predict = lua_toboolean(L, 5);
+    job->pass = lua_toboolean(L, 6);
+    memset(&job->stats, 0, sizeof(job->stats));
+    l_gus_search_params(L, 7, &job->search);
+    // the pondering shares the threads and the table, it has done its part by now
+    ponder_stop();
+    handle = async_submit(l_gus_run_job, job);
+    if(!handle) {
+        allocate(job, 0);
+        return 0;
+    }
+    lua_pushlightuserdata(L, handle);
+    if(l_gus_watch((int)(intptr_t)lua_touserdata(L, 1), async_fd(handle)) < 0) {
+        lua_pushnil(L);
     } else {
-        board_refresh(board, -1, -1, board->turn, 0);
-    }
-    if(ok >= 0) {
-        board->turn = board->turn == BLACK ? WHITE : BLACK;
-        if(predict) {
-            ok = board_predict(board, board->turn, &x, &y);
-            if(ok >= 0 || ok == ERR_PASS) {
-                if(ok == ERR_PASS) board->ko = -1;
-                board->turn = board->turn == BLACK ? WHITE : BLACK;
-            }
-        }
+        lua_pushlightuserdata(L, (void*)(intptr_t)async_fd(handle));
     }
-    lua_pushinteger(L, ok);
-    lua_pushinteger(L, x);
-    lua_pushinteger(L, y);
-    return 3;
+    return 2;
+}
+
+// returns the results of place and releases the handle, nothing while the
+// search is still running unless wait is set
+static int l_gus_collect(lua_State *L) {
+    ASYNC_JOB *handle;
+    L_GUS_JOB *job;
+    int n;
+    if(lua_gettop(L) < 1 || lua_type(L, 1) != LUA_TLIGHTUSERDATA) {
+        return luaL_error(L, "expecting 1 argument: handle (lightuserdata), [wait (bool)]");
+    }
+    handle = (ASYNC_JOB*)lua_touserdata(L, 1);
+    if(!async_done(handle)) {
+        if(lua_gettop(L) < 2 || !lua_toboolean(L, 2)) return 0;
+        async_wait(handle);
+    }
+    job = (L_GUS_JOB*)handle->ctx;
+    n = l_gus_push_result(L, job->ok, job->x, job->y, &job->stats);
+    // closing the fd also takes it out of the event loop
+    async_free(handle);
+    allocate(job, 0);
+    return n;
+}
+
+// thinks about the opponent's likely replies until the next place of this
+// worker, the board is copied and may be freed right after
+static int l_gus_ponder(lua_State *L) {
+    SEARCH_PARAMS search;
+    if(lua_gettop(L) < 1 || lua_type(L, 1) != LUA_TLIGHTUSERDATA) {
+        return luaL_error(L, "expecting 1 argument: board (lightuserdata), [search (table)]");
+    }
+    l_gus_search_params(L, 2, &search);
+    lua_pushboolean(L, ponder_start((BOARD*)lua_touserdata(L, 1), &search) >= 0);
+    return 1;
 }
 
 static int l_gus_state(lua_State *L) {
@@ -119,6 +278,33 @@ static int l_gus_state(lua_State *L) {
     return 1;
 }
 
+// Tromp-Taylor area count of the position as if the game ended now, with the
+// groups the estimator calls dead taken off unless dead is false
+static int l_gus_score(lua_State *L) {
+    AREA_SCORE area;
+    int margin;
+    if(lua_gettop(L) < 1 || lua_type(L, 1) != LUA_TLIGHTUSERDATA) {
+        return luaL_error(L, "expecting 1 argument: board (lightuserdata), [dead (bool)]");
+    }
+    margin = board_score_area((BOARD*)lua_touserdata(L, 1), DEFAULT_KOMI, lua_gettop(L) < 2 || lua_toboolean(L, 2), &area);
+    lua_newtable(L);
+    lua_pushinteger(L, area.black);
+    lua_setfield(L, -2, "black");
+    lua_pushinteger(L, area.white);
+    lua_setfield(L, -2, "white");
+    lua_pushinteger(L, area.dame);
+    lua_setfield(L, -2, "dame");
+    lua_pushinteger(L, area.dead_black);
+    lua_setfield(L, -2, "dead_black");
+    lua_pushinteger(L, area.dead_white);
+    lua_setfield(L, -2, "dead_white");
+    lua_pushnumber(L, DEFAULT_KOMI / 10.0);
+    lua_setfield(L, -2, "komi");
+    lua_pushnumber(L, margin / 10.0);
+    lua_setfield(L, -2, "margin");
+    return 1;
+}
+
 static int l_gus_new(lua_State *L) {
     if(lua_gettop(L) != 1 || lua_type(L, 1) != LUA_TNUMBER) {
         return luaL_error(L, "expecting 1 argument: size (int)");
@@ -126,7 +312,7 @@ static int l_gus_new(lua_State *L) {
     int size = lua_tointeger(L, 1);
     BOARD* board = allocate(NULL, sizeof(BOARD));
     if(!board) return 0;
-    board_init(board, size, 65);
+    board_init(board, size, DEFAULT_KOMI);
     lua_pushlightuserdata(L, board);
     return 1;
 }
@@ -141,36 +327,163 @@ static int l_gus_free(lua_State *L) {
 }
 
 static int l_gus_encode(lua_State *L) {
-    if(lua_gettop(L) != 1 || lua_type(L, 1) != LUA_TLIGHTUSERDATA) {
-        return luaL_error(L, "expecting 1 argument: board (lightuserdata)");
+    if(lua_gettop(L) < 1 || lua_type(L, 1) != LUA_TLIGHTUSERDATA) {
+        return luaL_error(L, "expecting 1 argument: board (lightuserdata), [format (\"text\" | \"binary\")]");
     }
     BOARD *board = (BOARD*)lua_touserdata(L, 1);
-    char data[board->square + 50];
-    board_encode(board, data, sizeof(data));
-    lua_pushstring(L, data);
+    const char *format = lua_gettop(L) > 1 && lua_type(L, 2) == LUA_TSTRING ? lua_tostring(L, 2) : "text";
+    char data[SESSION_MAX_TEXT + MAX_SQUARE + 50];
+    double started = stats_now_ms();
+    int n;
+    if(!strcmp(format, "binary")) {
+        n = board_encode_session(board, NULL, 0, data, sizeof(data));
+        if(n < 0) return 0;
+        lua_pushlstring(L, data, n);
+    } else {
+        board_encode(board, data, sizeof(data));
+        lua_pushstring(L, data);
+    }
+    STAT_TIME(PHASE_ENCODE, started);
     return 1;
 }
 
+// accepts both the text and the binary session format
 static int l_gus_decode(lua_State *L) {
     if(lua_gettop(L) != 1 || lua_type(L, 1) != LUA_TSTRING) {
         return luaL_error(L, "expecting 2 arguments: text (string)");
     }
-    const char *encoded = lua_tostring(L, 1);
-    BOARD *board = board_decode(encoded);
+    size_t len;
+    const char *encoded = lua_tolstring(L, 1, &len);
+    double started = stats_now_ms();
+    BOARD *board = (BOARD*)allocate(NULL, sizeof(BOARD));
     if(!board) return 0;
+    if(board_decode_session(board, NULL, NULL, encoded, len) < 0) {
+        allocate(board, 0);
+        return 0;
+    }
+    STAT_TIME(PHASE_DECODE, started);
     lua_pushlightuserdata(L, board);
     return 1;
 }
 
+#ifdef GUS_NO_STATS
+// the counters are compiled out, gus.stats() returns nil
+static int l_gus_stats(lua_State *L) {
+    return 0;
+}
+#else
+static void l_gus_push_counts(lua_State *L, const char *name, const char **keys, uint64_t *values, int n) {
+    int i;
+    lua_newtable(L);
+    for(i = 0; i < n; i++) {
+        if(!keys[i]) continue;
+        lua_pushinteger(L, (lua_Integer)values[i]);
+        lua_setfield(L, -2, keys[i]);
+    }
+    lua_setfield(L, -2, name);
+}
+
+// counters of all threads of this worker
+static int l_gus_stats(lua_State *L) {
+    static const char *errors[STATS_ERRORS] = { NULL, "placed", "oob", "suicide", "ko", "pass", "depth" };
+    static const char *engines[STATS_ENGINES] = { "beam", "mcts", "alphabeta" };
+    static const char *phases[STATS_PHASES] = { "decode", "place", "encode" };
+    AI_STATS stats;
+    int i, last = 0;
+    stats_collect(&stats);
+    lua_newtable(L);
+    lua_pushinteger(L, (lua_Integer)stats.places);
+    lua_setfield(L, -2, "places");
+    lua_pushinteger(L, (lua_Integer)stats.refreshes);
+    lua_setfield(L, -2, "refreshes");
+    lua_pushinteger(L, (lua_Integer)stats.copies);
+    lua_setfield(L, -2, "copies");
+    lua_pushinteger(L, (lua_Integer)stats.ratings);
+    lua_setfield(L, -2, "ratings");
+    lua_pushinteger(L, (lua_Integer)stats.candidates);
+    lua_setfield(L, -2, "candidates");
+    lua_pushinteger(L, (lua_Integer)stats.allocations);
+    lua_setfield(L, -2, "allocations");
+    lua_pushinteger(L, (lua_Integer)stats.ponder_probes);
+    lua_setfield(L, -2, "ponder_probes");
+    lua_pushinteger(L, (lua_Integer)stats.ponder_hits);
+    lua_setfield(L, -2, "ponder_hits");
+    lua_pushinteger(L, (lua_Integer)stats.tactics_reads);
+    lua_setfield(L, -2, "tactics_reads");
+    lua_pushinteger(L, (lua_Integer)stats.tactics_hits);
+    lua_setfield(L, -2, "tactics_hits");
+    l_gus_push_counts(L, "place_errors", errors, stats.place_errors, STATS_ERRORS);
+    l_gus_push_counts(L, "candidate_errors", errors, stats.candidate_errors, STATS_ERRORS);
+    l_gus_push_counts(L, "searches", engines, stats.searches, STATS_ENGINES);
+    l_gus_push_counts(L, "search_us", engines, stats.search_us, STATS_ENGINES);
+    l_gus_push_counts(L, "phases", phases, stats.phases, STATS_PHASES);
+    l_gus_push_counts(L, "phase_us", phases, stats.phase_us, STATS_PHASES);
+    // nodes[d] were searched d plies below the root, the list ends at the deepest ply
+    for(i = 0; i < STATS_MAX_DEPTH; i++) {
+        if(stats.nodes[i]) last = i;
+    }
+    lua_newtable(L);
+    for(i = 1; i <= last; i++) {
+        lua_pushinteger(L, (lua_Integer)stats.nodes[i]);
+        lua_rawseti(L, -2, i);
+    }
+    lua_setfield(L, -2, "nodes");
+    return 1;
+}
+#endif
+
+static int l_gus_cache_stats(lua_State *L) {
+    CACHE_STATS stats;
+    cache_stats(&stats);
+    lua_newtable(L);
+    lua_pushinteger(L, stats.buckets);
+    lua_setfield(L, -2, "buckets");
+    lua_pushinteger(L, stats.probes);
+    lua_setfield(L, -2, "probes");
+    lua_pushinteger(L, stats.hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, stats.stores);
+    lua_setfield(L, -2, "stores");
+    lua_pushinteger(L, stats.evictions);
+    lua_setfield(L, -2, "evictions");
+    return 1;
+}
+
+static int l_gus_tt_stats(lua_State *L) {
+    TT_STATS stats;
+    tt_stats(&stats);
+    lua_newtable(L);
+    lua_pushinteger(L, stats.entries);
+    lua_setfield(L, -2, "entries");
+    lua_pushinteger(L, stats.probes);
+    lua_setfield(L, -2, "probes");
+    lua_pushinteger(L, stats.hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, stats.stores);
+    lua_setfield(L, -2, "stores");
+    lua_pushinteger(L, stats.saved_ratings);
+    lua_setfield(L, -2, "saved_ratings");
+    lua_pushinteger(L, stats.saved_nodes);
+    lua_setfield(L, -2, "saved_nodes");
+    return 1;
+}
+
 static int luaopen_gus(lua_State *L) {
     int i;
     const luaL_Reg guslib[] = {
         {"place", l_gus_place},
+        {"place_async", l_gus_place_async},
+        {"collect", l_gus_collect},
+        {"ponder", l_gus_ponder},
         {"new", l_gus_new},
         {"free", l_gus_free},
         {"state", l_gus_state},
+        {"score", l_gus_score},
         {"encode", l_gus_encode},
         {"decode", l_gus_decode},
+        {"tt_stats", l_gus_tt_stats},
+        {"cache_stats", l_gus_cache_stats},
+        {"stats", l_gus_stats},
         {NULL, NULL}};
 #if LUA_VERSION_NUM > 501
     luaL_newlib(L, guslib);
@@ -181,7 +494,35 @@ static int luaopen_gus(lua_State *L) {
 }
 
 LIB_EXPORT int on_load(lua_State *L, serve_params *params, int reload) {
+    const char *tt_mb = getenv("GUS_TT_MB");
+    const char *threads = getenv("GUS_THREADS");
+    const char *weights = getenv("GUS_WEIGHTS");
+    const char *patterns = getenv("GUS_PATTERNS");
+    const char *async_threads = getenv("GUS_ASYNC_THREADS");
+    const char *cache_mb = getenv("GUS_CACHE_MB");
+    const char *cache_name = getenv("GUS_CACHE_NAME");
+    const char *book = getenv("GUS_BOOK");
+    const char *verbose = getenv("GUS_VERBOSE");
+    const char *ponder_replies = getenv("GUS_PONDER");
+    stats_verbose = verbose && atoi(verbose) > 0;
     ai_init();
+    if(weights && ai_load_weights(weights) < 0) {
+        fprintf(stderr, "gus: failed to load weights from %s, using defaults\n", weights);
+    }
+    if(patterns && *patterns && pattern_load(patterns) < 0) {
+        fprintf(stderr, "gus: failed to load patterns from %s, using defaults\n", patterns);
+    }
+    tt_init((size_t)(tt_mb ? atoi(tt_mb) : 16) << 20);
+    pool_init(threads ? atoi(threads) : 1);
+    async_init(async_threads ? atoi(async_threads) : 1);
+    ponder_init(ponder_replies ? atoi(ponder_replies) : 0);
+    if(cache_mb && atoi(cache_mb) > 0 && cache_init(cache_name ? cache_name : "/gus_cache", (size_t)atoi(cache_mb) << 20) < 0) {
+        fprintf(stderr, "gus: failed to map the shared position cache, searching without it\n");
+    }
+    // after the weights and patterns, a book built by another evaluation is refused
+    if(book && *book && book_open(book) < 0) {
+        fprintf(stderr, "gus: failed to open opening book %s, it is missing or was built for other weights\n", book);
+    }
 #if LUA_VERSION_NUM > 501
     luaL_requiref(L, "gus", luaopen_gus, 1);
     lua_pop(L, 1);
@@ -194,6 +535,14 @@ LIB_EXPORT int on_load(lua_State *L, serve_params *params, int reload) {
 }
 
 LIB_EXPORT int on_unload(lua_State *L, serve_params *params, int reload) {
-    // ...
+    // stopped before the queue goes away, it runs on an async thread
+    ponder_release();
+    async_release();
+    book_close();
+    cache_release();
+    tt_release();
+    pool_release();
+    // searches called from Lua allocated in this thread's arena
+    arena_release(arena_local());
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "ai.h"
+#include "stats.h"
+#include "pattern.h"
+#include "score.h"
+
+#define MCTS_EXPLORATION 0.7
+#define MCTS_EXPAND_AT 4
+#define MCTS_DEFAULT_PLAYOUTS 5000
+
+typedef struct mcts_node {
+    int first_child;
+    short n_children;
+    short move;         // board index of the move leading here
+    int visits;
+    float wins;         // from the perspective of the player who made the move
+} MCTS_NODE;
+
+typedef struct mcts_tree {
+    MCTS_NODE *nodes;
+    MOVE_INFO *moves;
+    int size;
+    int capacity;
+    uint64_t rng;
+} MCTS_TREE;
+
+static uint64_t mcts_random(MCTS_TREE *tree) {
+    uint64_t x = tree->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return tree->rng = x;
+}
+
+// point whose 3x3 pattern is pruned for the mover, an own eye by default
+static int mcts_pruned(BOARD *board, int place, CELL_COLOR color) {
+    return pattern_weights[pattern_code(board->patterns[place], color)] == PATTERN_PRUNE;
+}
+
+// quiet move that leaves its own group in atari, the tree tries it last and
+// playouts never play it
+static int mcts_self_atari(BOARD *board, int place, CELL_COLOR color) {
+    GROUP_STATE *groups = &board->groups;
+    MOVE_INFO info;
+    int size = board->size, x = place % size, around[4], i, k = 0, empty = 0, head;
+    if(x > 0) around[k++] = place - 1;
+    if(x + 1 < size) around[k++] = place + 1;
+    if(place >= size) around[k++] = place - size;
+    if(place + size < board->square) around[k++] = place + size;
+    // most points are told apart without reading the merged group: two empty
+    // neighbours or a joined group with three liberties leave two, a capture
+    // is no self-atari
+    for(i = 0; i < k; i++) {
+        head = groups->head[around[i]];
+        if(board->cells[around[i]].color == EMPTY) empty++;
+        else if(board->cells[around[i]].color == color ? groups->liberties[head] > 2 : groups->liberties[head] == 1) return 0;
+    }
+    if(empty > 1) return 0;
+    board_move_info(board, color, place, &info);
+    return info.err >= 0 && info.self_atari;
+}
+
+// expands all legal moves of the position but own eyes, self-ataris start with
+// a lost visit so they are tried once the others have been, returns -1 if out of memory
+static int mcts_expand(MCTS_TREE *tree, int index, BOARD *position, CELL_COLOR color) {
+    MCTS_NODE *nodes;
+    int i, m, first = tree->size, n = 0;
+    if(tree->size + position->square > tree->capacity) {
+        nodes = (MCTS_NODE*)allocate(tree->nodes, sizeof(MCTS_NODE) * (tree->capacity * 2 + position->square));
+        if(!nodes) return -1;
+        tree->nodes = nodes;
+        tree->capacity = tree->capacity * 2 + position->square;
+    }
+    m = board_generate_moves(position, color, tree->moves);
+    for(i = 0; i < m; i++) {
+        if(tree->moves[i].err < 0 || tree->moves[i].pruned) continue;
+        tree->nodes[first + n].first_child = -1;
+        tree->nodes[first + n].n_children = 0;
+        tree->nodes[first + n].move = tree->moves[i].place;
+        tree->nodes[first + n].visits = tree->moves[i].self_atari ? 1 : 0;
+        tree->nodes[first + n].wins = 0.0f;
+        n++;
+    }
+    tree->size += n;
+    tree->nodes[index].first_child = first;
+    tree->nodes[index].n_children = n;
+    return n;
+}
+
+static int mcts_select(MCTS_TREE *tree, int index) {
+    MCTS_NODE *node = tree->nodes + index, *child;
+    double best = -1.0, value, log_n = log((double)node->visits + 1.0);
+    int i, pick = node->first_child, offset = mcts_random(tree) % node->n_children;
+    for(i = 0; i < node->n_children; i++) {
+        child = tree->nodes + node->first_child + (i + offset) % node->n_children;
+        if(child->visits == 0) return child - tree->nodes;
+        value = child->wins / child->visits + MCTS_EXPLORATION * sqrt(log_n / child->visits);
+        if(value > best) {
+            best = value;
+            pick = child - tree->nodes;
+        }
+    }
+    return pick;
+}
+
+// light playout: uniformly random legal moves that don't fill own eyes or self-atari, returns winner
+static CELL_COLOR mcts_playout(MCTS_TREE *tree, BOARD *board, CELL_COLOR color) {
+    int empty[MAX_SQUARE], n_empty, i, p, placed, passes = 0, moves = 0, limit = board->square * 2;
+    while(passes < 2 && moves < limit) {
+        n_empty = 0;
+        placed = 0;
+        for(p = 0; p < board->square; p++) {
+            if(board->cells[p].color == EMPTY) empty[n_empty++] = p;
+        }
+        while(n_empty > 0 && !placed) {
+            i = mcts_random(tree) % n_empty;
+            p = empty[i];
+            empty[i] = empty[--n_empty];
+            if(mcts_pruned(board, p, color) || mcts_self_atari(board, p, color)) continue;
+            placed = board_place(board, p % board->size, p / board->size, color) >= 0;
+        }
+        if(placed) {
+            passes = 0;
+        } else {
+            passes++;
+            board_set_ko(board, -1);
+        }
+        color = color == BLACK ? WHITE : BLACK;
+        moves++;
+    }
+    // Tromp-Taylor area, playouts go on until dead stones are captured
+    return board_score_area(board, DEFAULT_KOMI, 0, NULL) > 0 ? BLACK : WHITE;
+}
+
+int board_predict_mcts(BOARD* board, CELL_COLOR color, SEARCH_PARAMS *params, SEARCH_STATS *stats, int *best_x, int *best_y) {
+    MCTS_TREE tree;
+    BOARD *scratch;
+    CELL_COLOR turn, winner;
+    int path[MAX_SQUARE * 2 + 2], depth, i, index, pv, playouts = 0, best = -1;
+    int budget = params && params->playouts > 0 ? params->playouts : params && params->nodes > 0 ? params->nodes : 0;
+    double started = stats_now_ms(), deadline = params && params->time_ms > 0 ? started + params->time_ms : 0.0;
+    if(!budget && deadline == 0.0) budget = MCTS_DEFAULT_PLAYOUTS;
+
+    tree.capacity = board->square * 64;
+    tree.size = 1;
+    tree.rng = board->hash | 1;
+    tree.nodes = (MCTS_NODE*)allocate(NULL, sizeof(MCTS_NODE) * tree.capacity);
+    tree.moves = (MOVE_INFO*)allocate(NULL, sizeof(MOVE_INFO) * MAX_SQUARE);
+    scratch = (BOARD*)allocate(NULL, sizeof(BOARD));
+    if(!tree.nodes || !tree.moves || !scratch) {
+        if(tree.nodes) allocate(tree.nodes, 0);
+        if(tree.moves) allocate(tree.moves, 0);
+        if(scratch) allocate(scratch, 0);
+        *best_x = -1;
+        *best_y = -1;
+        return ERR_PASS;
+    }
+    memset(tree.nodes, 0, sizeof(MCTS_NODE));
+    tree.nodes[0].first_child = -1;
+    tree.nodes[0].move = -1;
+
+    if(mcts_expand(&tree, 0, board, color) > 0) {
+        while((!budget || playouts < budget)
+            && (deadline == 0.0 || stats_now_ms() < deadline) && !SEARCH_ABORTED(params)) {
+            board_copy(scratch, board);
+            turn = color;
+            index = 0;
+            depth = 0;
+            path[depth++] = 0;
+            // selection, the path replays moves that were legal when expanded
+            while(tree.nodes[index].n_children > 0 && depth < MAX_SQUARE * 2) {
+                index = mcts_select(&tree, index);
+                board_place(scratch, tree.nodes[index].move % board->size, tree.nodes[index].move / board->size, turn);
+                turn = turn == BLACK ? WHITE : BLACK;
+                path[depth++] = index;
+            }
+            // expansion once the leaf has proven worth it
+            if(tree.nodes[index].visits >= MCTS_EXPAND_AT && tree.nodes[index].first_child < 0) {
+                if(mcts_expand(&tree, index, scratch, turn) < 0) break;
+                if(tree.nodes[index].n_children > 0) {
+                    index = mcts_select(&tree, index);
+                    board_place(scratch, tree.nodes[index].move % board->size, tree.nodes[index].move / board->size, turn);
+                    turn = turn == BLACK ? WHITE : BLACK;
+                    path[depth++] = index;
+                }
+            }
+            winner = mcts_playout(&tree, scratch, turn);
+            STAT_ADD(nodes[STATS_DEPTH(depth)], 1);
+            // backpropagation, a node's wins belong to the player who moved into it
+            turn = color;
+            for(i = 1; i < depth; i++) {
+                tree.nodes[path[i]].visits++;
+                if(winner == turn) tree.nodes[path[i]].wins += 1.0f;
+                turn = turn == BLACK ? WHITE : BLACK;
+            }
+            tree.nodes[0].visits++;
+            playouts++;
+        }
+        for(i = 0; i < tree.nodes[0].n_children; i++) {
+            index = tree.nodes[0].first_child + i;
+            if(best < 0 || tree.nodes[index].visits > tree.nodes[best].visits) best = index;
+        }
+    }
+
+    if(stats) {
+        stats->nodes = playouts;
+        stats->depth = 0;
+        // depth of the principal variation, following the most visited children
+        for(index = 0; tree.nodes[index].n_children > 0; stats->depth++) {
+            for(i = 0, pv = tree.nodes[index].first_child; i < tree.nodes[index].n_children; i++) {
+                if(tree.nodes[tree.nodes[index].first_child + i].visits > tree.nodes[pv].visits) pv = tree.nodes[index].first_child + i;
+            }
+            if(tree.nodes[pv].visits == 0) break;
+            index = pv;
+        }
+        stats->elapsed_ms = stats_now_ms() - started;
+    }
+    STAT_LOG("mcts: playouts: %d, nodes: %d, win rate: %f\n", playouts, tree.size,
+        best >= 0 && tree.nodes[best].visits ? tree.nodes[best].wins / tree.nodes[best].visits : 0.0);
+    i = best >= 0 ? tree.nodes[best].move : -1;
+    allocate(tree.nodes, 0);
+    allocate(tree.moves, 0);
+    allocate(scratch, 0);
+    if(i < 0) {
+        *best_x = -1;
+        *best_y = -1;
+        return ERR_PASS;
+    }
+    *best_x = i % board->size;
+    *best_y = i / board->size;
+    return board_place(board, *best_x, *best_y, color);
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <string.h>
+#include "ai.h"
+#include "pattern.h"
+
+float pattern_weights[PATTERN_CODES];
+static uint64_t fingerprint = 0;
+
+// rows top to bottom with the point in the middle, X mover, O opponent,
+// . empty, # off board, a anything but O, ? anything; every pattern also
+// matches its rotations and mirrors, later lines win, patterns.txt lists these
+static const char *pattern_defaults[] = {
+    // first and second line in an empty area
+    "###...... -300",
+    "####..#.. -600",
+    // contact with the opponent, hane and extension from own stones
+    "?O??.???? 200",
+    "?OXa.???? 300",
+    "?X??.???? 100",
+    // own true eyes, at most one opponent diagonal in the middle and none at the edge
+    "aXaX.XaXa prune",
+    "OXaX.XaXa prune",
+    "###X.XaXa prune",
+    "####.X#Xa prune",
+    NULL
+};
+
+// grid index of each code field, the middle cell 4 is the point itself
+static const int pattern_cells[8] = { 0, 1, 2, 3, 5, 6, 7, 8 };
+
+static int pattern_match(const char *grid, unsigned code) {
+    unsigned field;
+    int i;
+    for(i = 0; i < 8; i++) {
+        field = (code >> (2 * i)) & 3;
+        switch(grid[pattern_cells[i]]) {
+            case '.': if(field != 0) return 0; break;
+            case 'X': if(field != 1) return 0; break;
+            case 'O': if(field != 2) return 0; break;
+            case '#': if(field != PATTERN_EDGE) return 0; break;
+            case 'a': if(field == 2) return 0; break;
+            case '?': break;
+            default: return 0;
+        }
+    }
+    return 1;
+}
+
+// applies one "pattern weight" line to the table, -1 if malformed
+static int pattern_apply(const char *line) {
+    char text[16], value[32], grids[8][9];
+    float weight;
+    unsigned code;
+    int t, i, x, y, tx, ty;
+    if(sscanf(line, "%15s %31s", text, value) != 2 || strlen(text) != 9 || text[4] != '.') return -1;
+    if(!strcmp(value, "prune")) weight = PATTERN_PRUNE;
+    else if(sscanf(value, "%f", &weight) != 1) return -1;
+    for(i = 0; i < 9; i++) {
+        if(!strchr(".XO#a?", text[i])) return -1;
+    }
+    // same symmetry numbering as the board: bit 2 transposes, bit 0 and 1 mirror x and y
+    for(t = 0; t < 8; t++) {
+        for(i = 0; i < 9; i++) {
+            x = i % 3;
+            y = i / 3;
+            tx = t & 4 ? y : x;
+            ty = t & 4 ? x : y;
+            if(t & 1) tx = 2 - tx;
+            if(t & 2) ty = 2 - ty;
+            grids[t][ty * 3 + tx] = text[i];
+        }
+    }
+    for(code = 0; code < PATTERN_CODES; code++) {
+        for(t = 0; t < 8 && !pattern_match(grids[t], code); t++);
+        if(t < 8) pattern_weights[code] = weight;
+    }
+    return 0;
+}
+
+static void pattern_update_fingerprint() {
+    const unsigned char *p = (const unsigned char*)pattern_weights;
+    size_t i;
+    fingerprint = 0xCBF29CE484222325ULL;
+    for(i = 0; i < sizeof(pattern_weights); i++) {
+        fingerprint ^= p[i];
+        fingerprint *= 0x100000001B3ULL;
+    }
+}
+
+void pattern_init() {
+    int i;
+    memset(pattern_weights, 0, sizeof(pattern_weights));
+    for(i = 0; pattern_defaults[i]; i++) pattern_apply(pattern_defaults[i]);
+    pattern_update_fingerprint();
+}
+
+// text file of "pattern weight" lines, replaces the whole table, the
+// current one stays if the file is missing or malformed; # is also the off
+// board cell, so only a # followed by a space or the line end is a comment
+int pattern_load(const char *path) {
+    static float previous[PATTERN_CODES];
+    char line[256];
+    FILE *f = fopen(path, "r");
+    if(!f) return -1;
+    memcpy(previous, pattern_weights, sizeof(previous));
+    memset(pattern_weights, 0, sizeof(pattern_weights));
+    while(fgets(line, sizeof(line), f)) {
+        if((line[0] == '#' && strchr(" \t\r\n", line[1])) || line[strspn(line, " \t\r\n")] == 0) continue;
+        if(pattern_apply(line) < 0) {
+            memcpy(pattern_weights, previous, sizeof(previous));
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    pattern_update_fingerprint();
+    return 0;
+}
+
+// part of ai_eval_fingerprint, pruning and ordering change the searched replies
+uint64_t pattern_fingerprint() {
+    return fingerprint;
+}
@@ -0,0 +1,30 @@
+#ifndef __S80_GUS_PATTERN__
+#define __S80_GUS_PATTERN__
+#include <stdint.h>
+#include <math.h>
+#include "ai.h"
+
+// 3x3 neighbourhood of an empty point, 2 bits for each of the 8 neighbours in
+// row-major order, the first one in the lowest bits: empty 0, black 1, white 2,
+// off board 3; the table is indexed from the mover's view, mover 1, opponent 2
+#define PATTERN_CODES 65536
+#define PATTERN_EDGE 3
+#define PATTERN_PRUNE (-INFINITY)
+
+extern float pattern_weights[PATTERN_CODES];
+
+void pattern_init();
+int  pattern_load(const char *path);
+uint64_t pattern_fingerprint();
+
+// field of a neighbour with given color, empty is 0
+static inline unsigned pattern_field(CELL_COLOR color) {
+    return color == EMPTY ? 0 : color + 1;
+}
+
+// swaps black and white fields when white is to move, edges stay
+static inline unsigned pattern_code(unsigned code, CELL_COLOR color) {
+    unsigned swap = (code ^ (code >> 1)) & 0x5555;
+    return color == WHITE ? code ^ (swap | swap << 1) : code;
+}
+#endif
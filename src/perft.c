@@ -0,0 +1,262 @@
+#ifdef GUS_PERFT
+#include <stdio.h>
+#include <string.h>
+#include "ai.h"
+#include "bitboard.h"
+#include "stats.h"
+#include "arena.h"
+
+#define PERFT_MAX_DEPTH 8
+#define PERFT_MAX_REPORTS 5
+
+// outcomes of the moves tried at the last ply, chess perft style
+typedef struct perft_counts {
+    uint64_t leaves;
+    uint64_t captures;
+    uint64_t ko_bans;
+    uint64_t suicides;
+} PERFT_COUNTS;
+
+typedef struct perft_check {
+    UNDO_STACK undo;
+    BOARD reference[PERFT_MAX_DEPTH + 1];
+    BIT_BOARD bits[PERFT_MAX_DEPTH + 1];   // AVX2 rows, so the check comes from the aligned arena
+    BOARD unpacked;
+    uint64_t nodes;
+    uint64_t mismatches;
+} PERFT_CHECK;
+
+// move lists of the scenarios in main.c, 1-based x y pairs on 9x9
+static const char *perft_scenarios[] = {
+    "2 2 3 2 1 3 4 3 3 3 3 4 2 4 2 3 3 3",
+    "2 2 5 5 1 3 5 6 3 3 5 7 2 4",
+    "1 3 1 9 2 2 2 9 3 2 3 9 2 4 4 9 3 4 3 3 4 3 3 3"
+};
+
+// sessions that once made the engines disagree, a 5x5 board full of large
+// groups overran the board_refresh flood stack
+static const char *perft_regressions[] = {
+    "1 0005 -001 0010 0205 OOO++OOOOXOOOO+OOOXXOO+X+"
+};
+
+// random positions cover the size specialized kernels and the generic one
+static const int perft_sizes[] = { 5, 13, 17, 19 };
+
+static void perft_count(PERFT_COUNTS *counts, int ok) {
+    if(ok >= 0) {
+        counts->leaves++;
+        counts->captures += ok;
+    } else if(ok == ERR_KO) {
+        counts->ko_bans++;
+    } else if(ok == ERR_SUICIDE) {
+        counts->suicides++;
+    }
+}
+
+// group engine, moves are made and unmade in place
+static void perft_incremental(BOARD *board, UNDO_STACK *undo, int depth, CELL_COLOR color, PERFT_COUNTS *counts) {
+    CELL_COLOR other = color == BLACK ? WHITE : BLACK;
+    int p, ok;
+    for(p = 0; p < board->square; p++) {
+        if(board->cells[p].color != EMPTY) continue;
+        ok = board_make_move(board, undo, p % board->size, p / board->size, color);
+        if(depth <= 1) perft_count(counts, ok);
+        if(ok < 0) continue;
+        if(depth > 1) perft_incremental(board, undo, depth - 1, other, counts);
+        board_unmake_move(board, undo);
+    }
+}
+
+// board_refresh path, every move is played on a copy
+static void perft_reference(BOARD *boards, int depth, CELL_COLOR color, PERFT_COUNTS *counts) {
+    CELL_COLOR other = color == BLACK ? WHITE : BLACK;
+    int p, ok;
+    for(p = 0; p < boards->square; p++) {
+        if(boards->cells[p].color != EMPTY) continue;
+        board_copy(boards + 1, boards);
+        ok = board_place_reference(boards + 1, p % boards->size, p / boards->size, color);
+        if(depth <= 1) perft_count(counts, ok);
+        else if(ok >= 0) perft_reference(boards + 1, depth - 1, other, counts);
+    }
+}
+
+static void perft_bitboard(BIT_BOARD *bits, int depth, CELL_COLOR color, PERFT_COUNTS *counts) {
+    CELL_COLOR other = color == BLACK ? WHITE : BLACK;
+    int x, y, ok;
+    for(y = 0; y < bits->size; y++) {
+        for(x = 0; x < bits->size; x++) {
+            if(!bb_test(bits->planes + EMPTY, y * bits->stride + x)) continue;
+            bits[1] = bits[0];
+            ok = bit_board_place(bits + 1, x, y, color);
+            if(depth <= 1) perft_count(counts, ok);
+            else if(ok >= 0) perft_bitboard(bits + 1, depth - 1, other, counts);
+        }
+    }
+}
+
+// state every engine has to agree on after a move
+static int perft_same(BOARD *a, BOARD *b) {
+    int n;
+    if(a->ko != b->ko || a->black_score != b->black_score || a->white_score != b->white_score) return 0;
+    for(n = 0; n < a->square; n++) {
+        if(a->cells[n].color != b->cells[n].color) return 0;
+    }
+    return 1;
+}
+
+static void perft_report(PERFT_CHECK *check, BOARD *board, int place, CELL_COLOR color, const char *what) {
+    char text[MAX_SQUARE + 32];
+    if(++check->mismatches > PERFT_MAX_REPORTS) return;
+    board_encode(board, text, sizeof(text));
+    fprintf(stderr, "mismatch %s: %s at %d, %d in %s\n", what, color == BLACK ? "black" : "white", place % board->size, place / board->size, text);
+}
+
+// plays every move on all engines in lockstep, results and positions have to
+// match and the group records of the incremental engine have to pass board_verify
+static void perft_check(PERFT_CHECK *check, BOARD *board, int ply, int depth, CELL_COLOR color) {
+    CELL_COLOR other = color == BLACK ? WHITE : BLACK;
+    BOARD *reference = check->reference + ply;
+    BIT_BOARD *bits = check->bits + ply;
+    int p, ok, ok_reference, ok_bits;
+    for(p = 0; p < board->square; p++) {
+        if(board->cells[p].color != EMPTY) continue;
+        board_copy(reference + 1, reference);
+        bits[1] = bits[0];
+        ok = board_make_move(board, &check->undo, p % board->size, p / board->size, color);
+        ok_reference = board_place_reference(reference + 1, p % board->size, p / board->size, color);
+        ok_bits = bit_board_place(bits + 1, p % board->size, p / board->size, color);
+        check->nodes++;
+        if(ok != ok_reference || ok != ok_bits) {
+            perft_report(check, reference, p, color, "result");
+        } else if(ok >= 0) {
+            board_copy(&check->unpacked, board);
+            bit_board_to(bits + 1, &check->unpacked);
+            if(!perft_same(board, reference + 1)) perft_report(check, reference, p, color, "reference position");
+            else if(!perft_same(board, &check->unpacked)) perft_report(check, reference, p, color, "bitboard position");
+            else if(board->black_groups != reference[1].black_groups || board->white_groups != reference[1].white_groups
+                 || board->black_liberties != reference[1].black_liberties || board->white_liberties != reference[1].white_liberties) {
+                perft_report(check, reference, p, color, "group counts");
+            } else if(board_verify(board) < 0) {
+                perft_report(check, reference, p, color, "board_verify");
+            }
+        }
+        if(ok < 0) continue;
+        if(depth > 1) perft_check(check, board, ply + 1, depth - 1, other);
+        board_unmake_move(board, &check->undo);
+    }
+}
+
+static void perft_print(const char *engine, int position, BOARD *board, int depth, PERFT_COUNTS *counts, double elapsed) {
+    if(elapsed <= 0.0) elapsed = 1e-3;
+    fprintf(stderr, "perft engine=%s position=%d size=%d depth=%d leaves=%llu captures=%llu ko_bans=%llu suicides=%llu ms=%.2f leaves_per_s=%.0f\n",
+        engine, position, board->size, depth, (unsigned long long)counts->leaves, (unsigned long long)counts->captures,
+        (unsigned long long)counts->ko_bans, (unsigned long long)counts->suicides, elapsed, counts->leaves * 1000.0 / elapsed);
+}
+
+// checks the engines against each other on one position, then times each alone
+static uint64_t perft_position(int position, BOARD *board, int depth) {
+    ARENA *arena = arena_local();
+    PERFT_CHECK *check;
+    PERFT_COUNTS counts[3];
+    CELL_COLOR color = board->turn == WHITE ? WHITE : BLACK;
+    double started, elapsed;
+    uint64_t mismatches;
+    int i;
+    arena_reset(arena);
+    if(arena_reserve(arena, ARENA_SIZE(sizeof(PERFT_CHECK))) < 0) return 1;
+    check = (PERFT_CHECK*)arena_alloc(arena, sizeof(PERFT_CHECK));
+    board_undo_init(&check->undo);
+    board_copy(check->reference, board);
+    bit_board_from(check->bits, board);
+    check->nodes = 0;
+    check->mismatches = 0;
+    started = stats_now_ms();
+    perft_check(check, board, 0, depth, color);
+    fprintf(stderr, "check position=%d size=%d depth=%d nodes=%llu mismatches=%llu ms=%.2f\n", position, board->size, depth,
+        (unsigned long long)check->nodes, (unsigned long long)check->mismatches, stats_now_ms() - started);
+
+    memset(counts, 0, sizeof(counts));
+    started = stats_now_ms();
+    perft_incremental(board, &check->undo, depth, color, counts);
+    elapsed = stats_now_ms() - started;
+    perft_print("incremental", position, board, depth, counts, elapsed);
+    started = stats_now_ms();
+    perft_reference(check->reference, depth, color, counts + 1);
+    elapsed = stats_now_ms() - started;
+    perft_print("reference", position, board, depth, counts + 1, elapsed);
+    started = stats_now_ms();
+    perft_bitboard(check->bits, depth, color, counts + 2);
+    elapsed = stats_now_ms() - started;
+    perft_print("bitboard", position, board, depth, counts + 2, elapsed);
+    mismatches = check->mismatches;
+    for(i = 1; i < 3; i++) {
+        if(memcmp(counts, counts + i, sizeof(PERFT_COUNTS))) mismatches++;
+    }
+    return mismatches;
+}
+
+// plays a 1-based move list the way the interactive build does, illegal moves keep the turn
+static void perft_scenario(BOARD *board, const char *moves) {
+    int x, y, n;
+    board_init(board, 9, DEFAULT_KOMI);
+    while(sscanf(moves, "%d %d%n", &x, &y, &n) == 2) {
+        moves += n;
+        if(board_place(board, x - 1, y - 1, board->turn) >= 0) board_set_turn(board, board->turn == BLACK ? WHITE : BLACK);
+    }
+}
+
+static void perft_random(BOARD *board, int size, int moves, unsigned seed) {
+    int i, tries;
+    board_init(board, size, DEFAULT_KOMI);
+    srand(seed);
+    for(i = 0; i < moves; i++) {
+        for(tries = 0; tries < 100; tries++) {
+            if(board_place(board, rand() % size, rand() % size, board->turn) >= 0) break;
+        }
+        board_set_turn(board, board->turn == BLACK ? WHITE : BLACK);
+    }
+}
+
+// bin/gus-perft [depth] [positions in session format...], exits with 1 on any mismatch
+int main(int argc, const char **argv) {
+    BOARD *board = (BOARD*)allocate(NULL, sizeof(BOARD));
+    int depth = argc > 1 ? atoi(argv[1]) : 2, i, position = 0;
+    uint64_t mismatches = 0;
+    if(!board) return 1;
+    if(depth < 1 || depth > PERFT_MAX_DEPTH) {
+        fprintf(stderr, "usage: %s [depth = 2, at most %d] [positions...]\n", argv[0], PERFT_MAX_DEPTH);
+        return 1;
+    }
+    ai_init();
+    if(argc > 2) {
+        for(i = 2; i < argc; i++) {
+            if(board_decode_session(board, NULL, NULL, argv[i], strlen(argv[i])) < 0) {
+                fprintf(stderr, "perft: invalid position %s\n", argv[i]);
+                return 1;
+            }
+            mismatches += perft_position(position++, board, depth);
+        }
+    } else {
+        board_init(board, 5, DEFAULT_KOMI);
+        mismatches += perft_position(position++, board, depth);
+        board_init(board, 9, DEFAULT_KOMI);
+        mismatches += perft_position(position++, board, depth);
+        for(i = 0; i < (int)(sizeof(perft_scenarios) / sizeof(perft_scenarios[0])); i++) {
+            perft_scenario(board, perft_scenarios[i]);
+            mismatches += perft_position(position++, board, depth);
+        }
+        for(i = 0; i < (int)(sizeof(perft_regressions) / sizeof(perft_regressions[0])); i++) {
+            board_decode_session(board, NULL, NULL, perft_regressions[i], strlen(perft_regressions[i]));
+            mismatches += perft_position(position++, board, depth);
+        }
+        for(i = 0; i < (int)(sizeof(perft_sizes) / sizeof(perft_sizes[0])); i++) {
+            perft_random(board, perft_sizes[i], perft_sizes[i] * perft_sizes[i] / 2, 2000 + perft_sizes[i]);
+            mismatches += perft_position(position++, board, depth);
+        }
+    }
+    fprintf(stderr, "perft positions=%d depth=%d mismatches=%llu\n", position, depth, (unsigned long long)mismatches);
+    arena_release(arena_local());
+    allocate(board, 0);
+    return mismatches > 0;
+}
+#endif
@@ -0,0 +1,152 @@
+#include <string.h>
+#include <pthread.h>
+#include "ai.h"
+#include "async.h"
+#include "ponder.h"
+#include "stats.h"
+
+// searches done while the opponent thinks, keyed like the position cache, so
+// replies of several games share the table; the next request of a game is
+// answered from here when its opponent played one of them
+typedef struct ponder_entry {
+    uint64_t key;
+    short move;
+    unsigned char depth;
+    unsigned char used;
+} PONDER_ENTRY;
+
+typedef struct ponder_job {
+    BOARD board;
+    BOARD scratch;
+    UNDO_STACK undo;
+    MOVE_INFO moves[MAX_SQUARE];
+    double order[MAX_SQUARE];
+    SEARCH_PARAMS search;
+} PONDER_JOB;
+
+static struct {
+    pthread_mutex_t lock;
+    PONDER_ENTRY entries[PONDER_TABLE];
+    int next;           // ring position of the next new key
+    ASYNC_JOB *handle;
+    PONDER_JOB *job;
+    int replies;
+    int abort;
+} ponder = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+// a key already in the table is updated, a new one replaces the oldest entry
+static void ponder_store(uint64_t key, int move, int depth) {
+    PONDER_ENTRY *entry = NULL;
+    int i;
+    pthread_mutex_lock(&ponder.lock);
+    for(i = 0; i < PONDER_TABLE && !entry; i++) {
+        if(ponder.entries[i].used && ponder.entries[i].key == key) entry = ponder.entries + i;
+    }
+    if(!entry) {
+        entry = ponder.entries + ponder.next;
+        ponder.next = (ponder.next + 1) % PONDER_TABLE;
+    }
+    entry->key = key;
+    entry->move = move;
+    entry->depth = depth > 255 ? 255 : depth;
+    entry->used = 1;
+    pthread_mutex_unlock(&ponder.lock);
+}
+
+// searches the engine's answer to the most likely replies, best rated first,
+// so a stop after the first few still covers the replies that matter
+static void ponder_run(void *ctx) {
+    PONDER_JOB *job = (PONDER_JOB*)ctx;
+    BOARD *board = &job->board;
+    CELL_COLOR color = board->turn;
+    SEARCH_STATS stats;
+    uint64_t key;
+    int i, j, best, n, x, y, ok, symmetry_index, stored = 0;
+    double started = stats_now_ms();
+    n = board_generate_moves(board, color, job->moves);
+    for(i = 0; i < n; i++) {
+        job->order[i] = job->moves[i].err < 0 || job->moves[i].pruned ? -1e300 : board_rate_child(board, &job->undo, color, job->moves + i);
+    }
+    for(i = 0; i < ponder.replies && !SEARCH_ABORTED(&job->search); i++) {
+        for(j = 0, best = -1; j < n; j++) {
+            if(job->order[j] > -1e300 && (best < 0 || job->order[j] > job->order[best])) best = j;
+        }
+        if(best < 0) break;
+        job->order[best] = -1e300;
+        board_copy(&job->scratch, board);
+        if(board_place(&job->scratch, job->moves[best].place % board->size, job->moves[best].place / board->size, color) < 0) continue;
+        board_set_turn(&job->scratch, color == BLACK ? WHITE : BLACK);
+        symmetry_index = board_canonical(&job->scratch, &key);
+        key = search_cache_key(key, &job->search);
+        ok = board_search_cached(&job->scratch, &job->search, &stats, &x, &y);
+        if(SEARCH_ABORTED(&job->search)) break;
+        if(ok >= 0) ponder_store(key, board_to_canonical(&job->scratch, symmetry_index, y * board->size + x), stats.depth);
+        else if(ok == ERR_PASS) ponder_store(key, -1, stats.depth);
+        else continue;
+        stored++;
+    }
+    STAT_LOG("ponder: replies: %d, ms: %f\n", stored, stats_now_ms() - started);
+}
+
+// replies is the number of opponent moves searched ahead, 0 disables pondering
+int ponder_init(int replies) {
+    ponder_release();
+    if(replies < 0) replies = 0;
+    if(replies > PONDER_MAX_REPLIES) replies = PONDER_MAX_REPLIES;
+    ponder.replies = replies;
+    return 0;
+}
+
+void ponder_release() {
+    ponder_stop();
+    if(ponder.job) allocate(ponder.job, 0);
+    ponder.job = NULL;
+    pthread_mutex_lock(&ponder.lock);
+    memset(ponder.entries, 0, sizeof(ponder.entries));
+    ponder.next = 0;
+    pthread_mutex_unlock(&ponder.lock);
+}
+
+// starts thinking on the opponent's time, the board is copied, so it can be
+// freed right away; earlier pondering is stopped, the replies it found stay
+int ponder_start(BOARD *board, SEARCH_PARAMS *search) {
+    if(!ponder.replies) return 0;
+    ponder_stop();
+    if(!ponder.job) ponder.job = (PONDER_JOB*)allocate(NULL, sizeof(PONDER_JOB));
+    if(!ponder.job) return -1;
+    board_copy(&ponder.job->board, board);
+    board_undo_init(&ponder.job->undo);
+    ponder.job->search = *search;
+    ponder.job->search.abort = &ponder.abort;
+    __atomic_store_n(&ponder.abort, 0, __ATOMIC_RELAXED);
+    ponder.handle = async_submit(ponder_run, ponder.job);
+    return ponder.handle ? 0 : -1;
+}
+
+// cuts the running search short and waits for it, finished replies are kept
+void ponder_stop() {
+    if(!ponder.handle) return;
+    __atomic_store_n(&ponder.abort, 1, __ATOMIC_RELAXED);
+    async_wait(ponder.handle);
+    async_free(ponder.handle);
+    ponder.handle = NULL;
+}
+
+int ponder_probe(uint64_t key, int *move, int *depth) {
+    int i, found = 0;
+    if(!ponder.replies) return 0;
+    pthread_mutex_lock(&ponder.lock);
+    for(i = 0; i < PONDER_TABLE && !found; i++) {
+        if(ponder.entries[i].used && ponder.entries[i].key == key) {
+            *move = ponder.entries[i].move;
+            *depth = ponder.entries[i].depth;
+            found = 1;
+        }
+    }
+    pthread_mutex_unlock(&ponder.lock);
+    STAT_ADD(ponder_probes, 1);
+    if(found) STAT_ADD(ponder_hits, 1);
+    return found;
+}
@@ -0,0 +1,15 @@
+#ifndef __S80_GUS_PONDER__
+#define __S80_GUS_PONDER__
+#include <stdint.h>
+#include "ai.h"
+
+#define PONDER_MAX_REPLIES 16
+// pondered replies kept for all games of the worker, the oldest go first
+#define PONDER_TABLE 256
+
+int  ponder_init(int replies);
+void ponder_release();
+int  ponder_start(BOARD *board, SEARCH_PARAMS *search);
+void ponder_stop();
+int  ponder_probe(uint64_t key, int *move, int *depth);
+#endif
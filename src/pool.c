@@ -0,0 +1,153 @@
+#include <pthread.h>
+#include <stdint.h>
+#include "pool.h"
+
+// each worker owns a [begin, end) range packed into one word, the owner pops
+// from the front and thieves cut off the back half, both with a single CAS
+typedef struct pool_range {
+    uint64_t packed;
+    char padding[56];
+} POOL_RANGE;
+
+static struct {
+    pthread_t threads[POOL_MAX_THREADS];
+    POOL_RANGE ranges[POOL_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    pthread_mutex_t run_lock;
+    POOL_TASK task;
+    void *ctx;
+    int n_threads;
+    int first_job;
+    int job;
+    int active;
+    int stop;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .run_lock = PTHREAD_MUTEX_INITIALIZER,
+    .n_threads = 1
+};
+
+#define RANGE(begin, end) (((uint64_t)(uint32_t)(begin) << 32) | (uint32_t)(end))
+#define RANGE_BEGIN(r) ((int)((r) >> 32))
+#define RANGE_END(r) ((int)((r) & 0xFFFFFFFF))
+
+static int pool_pop(int worker) {
+    POOL_RANGE *range = pool.ranges + worker;
+    uint64_t r = __atomic_load_n(&range->packed, __ATOMIC_ACQUIRE);
+    while(RANGE_BEGIN(r) < RANGE_END(r)) {
+        if(__atomic_compare_exchange_n(&range->packed, &r, RANGE(RANGE_BEGIN(r) + 1, RANGE_END(r)), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return RANGE_BEGIN(r);
+        }
+    }
+    return -1;
+}
+
+static int pool_steal(int worker) {
+    POOL_RANGE *range;
+    uint64_t r;
+    int i, begin, mid, end;
+    for(i = 1; i < pool.n_threads; i++) {
+        range = pool.ranges + (worker + i) % pool.n_threads;
+        r = __atomic_load_n(&range->packed, __ATOMIC_ACQUIRE);
+        while(RANGE_BEGIN(r) < RANGE_END(r)) {
+            begin = RANGE_BEGIN(r);
+            end = RANGE_END(r);
+            mid = begin + (end - begin) / 2;
+            if(__atomic_compare_exchange_n(&range->packed, &r, RANGE(begin, mid), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_store_n(&pool.ranges[worker].packed, RANGE(mid + 1, end), __ATOMIC_RELEASE);
+                return mid;
+            }
+        }
+    }
+    return -1;
+}
+
+static void pool_work(int worker) {
+    int index;
+    for(;;) {
+        index = pool_pop(worker);
+        if(index < 0) index = pool_steal(worker);
+        if(index < 0) break;
+        pool.task(pool.ctx, index, worker);
+    }
+}
+
+static void *pool_main(void *arg) {
+    int worker = (int)(intptr_t)arg, job;
+    pthread_mutex_lock(&pool.lock);
+    // a job may have been posted before this thread got the lock for the first time
+    job = pool.first_job;
+    for(;;) {
+        while(!pool.stop && pool.job == job) pthread_cond_wait(&pool.wake, &pool.lock);
+        if(pool.stop) break;
+        job = pool.job;
+        pthread_mutex_unlock(&pool.lock);
+        pool_work(worker);
+        pthread_mutex_lock(&pool.lock);
+        if(--pool.active == 0) pthread_cond_signal(&pool.done);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+int pool_init(int threads) {
+    int i;
+    if(threads < 1) threads = 1;
+    if(threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+    if(threads == pool.n_threads) return 0;
+    pool_release();
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = 0;
+    pool.first_job = pool.job;
+    for(i = 1; i < threads; i++) {
+        if(pthread_create(pool.threads + i, NULL, pool_main, (void*)(intptr_t)i) != 0) break;
+    }
+    pool.n_threads = i;
+    pthread_mutex_unlock(&pool.lock);
+    return i == threads ? 0 : -1;
+}
+
+void pool_release() {
+    int i;
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+    for(i = 1; i < pool.n_threads; i++) pthread_join(pool.threads[i], NULL);
+    pool.n_threads = 1;
+}
+
+int pool_threads() {
+    return pool.n_threads;
+}
+
+void pool_run(POOL_TASK task, void *ctx, int count) {
+    int i, n;
+    // tiny jobs, single thread or pool already busy with another caller run inline
+    if(pool.n_threads == 1 || count < 2 || pthread_mutex_trylock(&pool.run_lock) != 0) {
+        for(i = 0; i < count; i++) task(ctx, i, 0);
+        return;
+    }
+    n = pool.n_threads;
+    for(i = 0; i < n; i++) {
+        pool.ranges[i].packed = RANGE((int64_t)count * i / n, (int64_t)count * (i + 1) / n);
+    }
+    pthread_mutex_lock(&pool.lock);
+    pool.task = task;
+    pool.ctx = ctx;
+    pool.active = n - 1;
+    pool.job++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    pool_work(0);
+
+    pthread_mutex_lock(&pool.lock);
+    while(pool.active > 0) pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool.run_lock);
+}
@@ -0,0 +1,14 @@
+#ifndef __S80_GUS_POOL__
+#define __S80_GUS_POOL__
+
+#define POOL_MAX_THREADS 64
+
+// task(ctx, index, worker) is called once for every index in [0, count),
+// worker is in [0, pool_threads()) and can be used to pick per-thread scratch
+typedef void (*POOL_TASK)(void *ctx, int index, int worker);
+
+int  pool_init(int threads);
+void pool_release();
+int  pool_threads();
+void pool_run(POOL_TASK task, void *ctx, int count);
+#endif
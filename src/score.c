@@ -0,0 +1,185 @@
+#include <string.h>
+#include "score.h"
+
+// one bit per point with a guard column per row like bitboard.h, sized for
+// the board at hand so 9x9 fits two words and 19x19 six
+#define SCORE_WORDS(size) ((((size) + 1) * (size) + 63) / 64)
+#define SCORE_MAX_WORDS SCORE_WORDS(MAX_BOARD)
+#define SCORE_KERNEL static inline __attribute__((always_inline))
+
+typedef struct score_planes {
+    uint64_t stones[2][SCORE_MAX_WORDS];    // indexed by CELL_COLOR
+    uint64_t empty[SCORE_MAX_WORDS];
+    uint64_t reach[2][SCORE_MAX_WORDS];     // empty points connected to stones of the color, set by score_count_n
+} SCORE_PLANES;
+
+// a plus its neighbours that are empty, guard bits are never empty so shifts
+// across the row ends and past the last row fall off
+SCORE_KERNEL void score_dilate_n(uint64_t *out, const uint64_t *a, const uint64_t *empty, int stride, const int W) {
+    uint64_t lo, hi;
+    int i;
+    for(i = 0; i < W; i++) {
+        lo = i > 0 ? a[i - 1] : 0;
+        hi = i + 1 < W ? a[i + 1] : 0;
+        out[i] = a[i] | (((a[i] << 1) | (lo >> 63) | (a[i] >> 1) | (hi << 63)
+            | (a[i] << stride) | (lo >> (64 - stride)) | (a[i] >> stride) | (hi << (64 - stride))) & empty[i]);
+    }
+}
+
+// empty points reachable from the stones, grows every region by one step at a
+// time until nothing changes, so the rounds are bounded by the widest region
+SCORE_KERNEL void score_reach_n(uint64_t *reach, const uint64_t *stones, const uint64_t *empty, int stride, const int W) {
+    uint64_t next[SCORE_MAX_WORDS], diff;
+    int i;
+    score_dilate_n(next, stones, empty, stride, W);
+    for(i = 0; i < W; i++) reach[i] = next[i] & empty[i];
+    do {
+        score_dilate_n(next, reach, empty, stride, W);
+        for(i = 0, diff = 0; i < W; i++) {
+            diff |= next[i] ^ reach[i];
+            reach[i] = next[i];
+        }
+    } while(diff);
+}
+
+SCORE_KERNEL void score_planes(BOARD *board, SCORE_PLANES *planes, int stride) {
+    uint64_t *by_color[3] = { planes->stones[BLACK], planes->stones[WHITE], planes->empty };
+    int x, y, p = 0, bit;
+    memset(planes->stones, 0, sizeof(planes->stones));
+    memset(planes->empty, 0, sizeof(planes->empty));
+    for(y = 0; y < board->size; y++) {
+        for(x = 0, bit = y * stride; x < board->size; x++, p++, bit++) {
+            by_color[board->cells[p].color][bit >> 6] |= 1ULL << (bit & 63);
+        }
+    }
+}
+
+SCORE_KERNEL void score_count_n(SCORE_PLANES *planes, AREA_SCORE *out, int stride, const int W) {
+    int i;
+    score_reach_n(planes->reach[BLACK], planes->stones[BLACK], planes->empty, stride, W);
+    score_reach_n(planes->reach[WHITE], planes->stones[WHITE], planes->empty, stride, W);
+    out->black = 0;
+    out->white = 0;
+    for(i = 0; i < W; i++) {
+        out->black += __builtin_popcountll(planes->stones[BLACK][i]) + __builtin_popcountll(planes->reach[BLACK][i] & ~planes->reach[WHITE][i]);
+        out->white += __builtin_popcountll(planes->stones[WHITE][i]) + __builtin_popcountll(planes->reach[WHITE][i] & ~planes->reach[BLACK][i]);
+    }
+}
+
+static inline int score_test(const uint64_t *plane, int bit) {
+    return (plane[bit >> 6] >> (bit & 63)) & 1;
+}
+
+// stones of the color next to the empty region
+SCORE_KERNEL int score_border_n(const uint64_t *region, const uint64_t *stones, int stride, const int W) {
+    uint64_t grown[SCORE_MAX_WORDS];
+    int i, n = 0;
+    score_dilate_n(grown, region, stones, stride, W);
+    for(i = 0; i < W; i++) n += __builtin_popcountll(grown[i] & ~region[i]);
+    return n;
+}
+
+// points of the mask connected to the lowest one set in the given word
+SCORE_KERNEL void score_region_n(uint64_t *region, const uint64_t *mask, int word, int stride, const int W) {
+    uint64_t next[SCORE_MAX_WORDS], diff;
+    int i;
+    memset(region, 0, sizeof(uint64_t) * SCORE_MAX_WORDS);
+    region[word] = mask[word] & -mask[word];
+    do {
+        score_dilate_n(next, region, mask, stride, W);
+        for(i = 0, diff = 0; i < W; i++) {
+            diff |= next[i] ^ region[i];
+            region[i] = next[i];
+        }
+    } while(diff);
+}
+
+// cheap dead group estimate: the points that aren't stones of one color split
+// into regions enclosed by that color, and one smaller than half the board is
+// its territory; stones of the other color in there are dead unless they have
+// an eye, an empty region smaller than half the board whose border holds more
+// of their stones than of the enclosing color's. In the opening every region
+// spans the board, so nothing is taken off
+SCORE_KERNEL int score_dead_n(BOARD *board, SCORE_PLANES *planes, AREA_SCORE *out, int stride, const int W) {
+    uint64_t eyes[2][SCORE_MAX_WORDS], dead[2][SCORE_MAX_WORDS], left[SCORE_MAX_WORDS], region[SCORE_MAX_WORDS], inside, alive;
+    CELL_COLOR color, other;
+    int first, i, size, black, white, n = 0;
+    memset(eyes, 0, sizeof(eyes));
+    memset(dead, 0, sizeof(dead));
+    memcpy(left, planes->empty, sizeof(left));
+    for(first = 0; first < W; ) {
+        if(!left[first]) {
+            first++;
+            continue;
+        }
+        score_region_n(region, left, first, stride, W);
+        black = score_border_n(region, planes->stones[BLACK], stride, W);
+        white = score_border_n(region, planes->stones[WHITE], stride, W);
+        for(i = 0, size = 0; i < W; i++) {
+            left[i] &= ~region[i];
+            size += __builtin_popcountll(region[i]);
+        }
+        if(size * 2 >= board->square) continue;
+        for(i = 0; i < W; i++) {
+            if(black > white) eyes[BLACK][i] |= region[i];
+            else if(white > black) eyes[WHITE][i] |= region[i];
+        }
+    }
+    for(color = BLACK; color <= WHITE; color++) {
+        other = color == BLACK ? WHITE : BLACK;
+        for(i = 0; i < W; i++) left[i] = planes->empty[i] | planes->stones[other][i];
+        for(first = 0; first < W; ) {
+            if(!left[first]) {
+                first++;
+                continue;
+            }
+            score_region_n(region, left, first, stride, W);
+            for(i = 0, size = 0, inside = 0, alive = 0; i < W; i++) {
+                left[i] &= ~region[i];
+                size += __builtin_popcountll(region[i]);
+                inside |= region[i] & planes->stones[other][i];
+                alive |= region[i] & eyes[other][i];
+            }
+            if(!inside || alive || size * 2 >= board->square) continue;
+            for(i = 0; i < W; i++) dead[other][i] |= region[i] & planes->stones[other][i];
+        }
+    }
+    // taken off once both colors are done, so neither pass sees the other's removals
+    for(color = BLACK; color <= WHITE; color++) {
+        for(i = 0, size = 0; i < W; i++) {
+            planes->stones[color][i] &= ~dead[color][i];
+            planes->empty[i] |= dead[color][i];
+            size += __builtin_popcountll(dead[color][i]);
+        }
+        if(color == BLACK) out->dead_black = size;
+        else out->dead_white = size;
+        n += size;
+    }
+    return n;
+}
+
+SCORE_KERNEL int score_area_n(BOARD *board, int komi, int estimate_dead, AREA_SCORE *out, const int W) {
+    SCORE_PLANES planes;
+    int stride = board->size + 1;
+    score_planes(board, &planes, stride);
+    out->dead_black = 0;
+    out->dead_white = 0;
+    // dead stones turn into empty points before the regions are flooded
+    if(estimate_dead) score_dead_n(board, &planes, out, stride, W);
+    score_count_n(&planes, out, stride, W);
+    out->dame = board->square - out->black - out->white;
+    return (out->black - out->white) * 10 - komi;
+}
+
+int board_score_area(BOARD *board, int komi, int estimate_dead, AREA_SCORE *out) {
+    AREA_SCORE tmp;
+    if(!out) out = &tmp;
+    switch(SCORE_WORDS(board->size)) {
+        case 0: case 1: case 2:
+            return score_area_n(board, komi, estimate_dead, out, 2);
+        case 3:
+            return score_area_n(board, komi, estimate_dead, out, 3);
+        default:
+            return score_area_n(board, komi, estimate_dead, out, SCORE_MAX_WORDS);
+    }
+}
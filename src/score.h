@@ -0,0 +1,18 @@
+#ifndef __S80_GUS_SCORE__
+#define __S80_GUS_SCORE__
+#include "ai.h"
+
+// Tromp-Taylor area of both colors, a point counts for a color when it holds
+// one of its stones or is empty and reaches only its stones through empty points
+typedef struct area_score {
+    short black;
+    short white;
+    short dame;         // empty points that reach both colors or none
+    short dead_black;   // stones taken off by the estimator, they count as white area
+    short dead_white;
+} AREA_SCORE;
+
+// returns black's margin in tenths of a point after komi, positive when black
+// wins, with estimate_dead set groups the estimator calls dead are removed first
+int board_score_area(BOARD *board, int komi, int estimate_dead, AREA_SCORE *out);
+#endif
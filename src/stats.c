@@ -0,0 +1,49 @@
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "ai.h"
+#include "stats.h"
+
+int stats_verbose = 0;
+
+#ifndef GUS_NO_STATS
+__thread AI_STATS *stats_thread = NULL;
+static AI_STATS *stats_list = NULL;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// blocks are kept for the lifetime of the process, so totals never go back
+// when search threads are replaced
+AI_STATS *stats_register() {
+    static AI_STATS fallback;
+    // not allocate(), it counts into the block that is being created
+    AI_STATS *block = (AI_STATS*)calloc(1, sizeof(AI_STATS));
+    if(!block) return stats_thread = &fallback;
+    pthread_mutex_lock(&stats_lock);
+    block->next = stats_list;
+    stats_list = block;
+    pthread_mutex_unlock(&stats_lock);
+    return stats_thread = block;
+}
+#endif
+
+double stats_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// sum over all threads, a thread may be half way through a search
+void stats_collect(AI_STATS *out) {
+    memset(out, 0, sizeof(AI_STATS));
+#ifndef GUS_NO_STATS
+    AI_STATS *block;
+    uint64_t *sum = (uint64_t*)out, *word;
+    size_t i, n = offsetof(AI_STATS, next) / sizeof(uint64_t);
+    pthread_mutex_lock(&stats_lock);
+    for(block = stats_list; block; block = block->next) {
+        word = (uint64_t*)block;
+        for(i = 0; i < n; i++) sum[i] += __atomic_load_n(word + i, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&stats_lock);
+#endif
+}
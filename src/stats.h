@@ -0,0 +1,66 @@
+#ifndef __S80_GUS_STATS__
+#define __S80_GUS_STATS__
+#include <stdio.h>
+#include <stdint.h>
+
+#define STATS_MAX_DEPTH 32
+#define STATS_ERRORS 7          // indexed by -ERR_*, 0 is unused
+#define STATS_ENGINES 3         // indexed by SEARCH_ENGINE
+#define STATS_DEPTH(d) ((d) < STATS_MAX_DEPTH ? (d) : STATS_MAX_DEPTH - 1)
+
+typedef enum stats_phase {
+    PHASE_DECODE = 0,
+    PHASE_PLACE,
+    PHASE_ENCODE,
+    STATS_PHASES
+} STATS_PHASE;
+
+// counters of one thread, only words, so blocks can be summed as arrays
+typedef struct ai_stats {
+    uint64_t places;
+    uint64_t place_errors[STATS_ERRORS];
+    uint64_t refreshes;
+    uint64_t copies;
+    uint64_t ratings;
+    uint64_t candidates;
+    uint64_t candidate_errors[STATS_ERRORS];
+    uint64_t allocations;
+    uint64_t nodes[STATS_MAX_DEPTH];
+    uint64_t searches[STATS_ENGINES];
+    uint64_t search_us[STATS_ENGINES];
+    uint64_t phases[STATS_PHASES];
+    uint64_t phase_us[STATS_PHASES];
+    uint64_t ponder_probes;
+    uint64_t ponder_hits;
+    uint64_t tactics_reads;
+    uint64_t tactics_hits;
+    struct ai_stats *next;
+} AI_STATS;
+
+extern int stats_verbose;
+
+double stats_now_ms();
+void   stats_collect(AI_STATS *out);
+
+#ifdef GUS_NO_STATS
+// arguments stay referenced so release builds don't warn about unused values
+#define STAT_ADD(field, n) do { if(0) (void)(n); } while(0)
+#define STAT_TIME(phase, started) do { if(0) (void)(started); } while(0)
+#define STAT_LOG(...) do { if(0) fprintf(stderr, __VA_ARGS__); } while(0)
+#else
+extern __thread AI_STATS *stats_thread;
+AI_STATS *stats_register();
+
+// single writer per block, relaxed accesses only keep the readers well defined
+static inline void stats_add(uint64_t *counter, uint64_t n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+#define STAT_ADD(field, n) stats_add(&(stats_thread ? stats_thread : stats_register())->field, (n))
+#define STAT_TIME(phase, started) do { \
+        STAT_ADD(phases[phase], 1); \
+        STAT_ADD(phase_us[phase], (uint64_t)((stats_now_ms() - (started)) * 1000.0)); \
+    } while(0)
+#define STAT_LOG(...) do { if(stats_verbose) fprintf(stderr, __VA_ARGS__); } while(0)
+#endif
+#endif
@@ -0,0 +1,240 @@
+#include <string.h>
+#include "tactics.h"
+#include "stats.h"
+
+#define TACTICS_MAX_DEFENCES 8
+
+// one reading, moves are made on the caller's board and unmade before it returns
+typedef struct tactics_read {
+    BOARD *board;
+    UNDO_STACK *undo;
+    int place;          // stone of the group that is read, it stays while the group lives
+    CELL_COLOR target;  // color of the group
+    int nodes;
+} TACTICS_READ;
+
+static int tactics_neighbours(BOARD *board, int place, int *out) {
+    int size = board->size, n = 0;
+    if(place % size > 0) out[n++] = place - 1;
+    if(place % size + 1 < size) out[n++] = place + 1;
+    if(place >= size) out[n++] = place - size;
+    if(place + size < board->square) out[n++] = place + size;
+    return n;
+}
+
+static int tactics_add(int *out, int n, int place) {
+    int i;
+    for(i = 0; i < n; i++) {
+        if(out[i] == place) return n;
+    }
+    out[n] = place;
+    return n + 1;
+}
+
+static inline int tactics_libs(BOARD *board, int place) {
+    return board->groups.liberties[board->groups.head[place]];
+}
+
+// up to max distinct liberties of the group the stone belongs to
+static int tactics_liberties(BOARD *board, int place, int *out, int max) {
+    GROUP_STATE *groups = &board->groups;
+    int head = groups->head[place], stone = head, around[4], i, k, n = 0;
+    do {
+        k = tactics_neighbours(board, stone, around);
+        for(i = 0; i < k && n < max; i++) {
+            if(board->cells[around[i]].color == EMPTY) n = tactics_add(out, n, around[i]);
+        }
+        stone = groups->next[stone];
+    } while(stone != head && n < max);
+    return n;
+}
+
+// moves that capture an enemy group in atari next to the group, up to max
+static int tactics_counter_captures(BOARD *board, int place, int *out, int max) {
+    GROUP_STATE *groups = &board->groups;
+    CELL_COLOR enemy = board->cells[place].color == BLACK ? WHITE : BLACK;
+    int head = groups->head[place], stone = head, around[4], liberty, i, k, n = 0;
+    do {
+        k = tactics_neighbours(board, stone, around);
+        for(i = 0; i < k && n < max; i++) {
+            if(board->cells[around[i]].color != enemy || tactics_libs(board, around[i]) != 1) continue;
+            if(tactics_liberties(board, around[i], &liberty, 1) == 1) n = tactics_add(out, n, liberty);
+        }
+        stone = groups->next[stone];
+    } while(stone != head && n < max);
+    return n;
+}
+
+// empty neighbours of the point but one
+static int tactics_open(BOARD *board, int place, int except) {
+    int around[4], i, k, n = 0;
+    k = tactics_neighbours(board, place, around);
+    for(i = 0; i < k; i++) {
+        if(around[i] != except && board->cells[around[i]].color == EMPTY) n++;
+    }
+    return n;
+}
+
+static int tactics_play(TACTICS_READ *read, int place, CELL_COLOR color) {
+    read->nodes++;
+    return board_make_move(read->board, read->undo, place % read->board->size, place / read->board->size, color) >= 0;
+}
+
+static int tactics_defend(TACTICS_READ *read, int depth, int *move);
+
+// attacker to move, returns 1 when the group is captured, only ataris are
+// read, so a group with two liberties dies in ladders but not in nets
+static int tactics_attack(TACTICS_READ *read, int depth, int *move) {
+    BOARD *board = read->board;
+    CELL_COLOR attacker = read->target == BLACK ? WHITE : BLACK;
+    int liberties[2], n, i, reply, captured, libs = tactics_libs(board, read->place);
+    *move = -1;
+    if(libs > 2) return 0;
+    n = tactics_liberties(board, read->place, liberties, 2);
+    if(libs == 1) {
+        // a ko ban or a full undo stack keeps the group alive for now
+        if(!tactics_play(read, liberties[0], attacker)) return 0;
+        board_unmake_move(board, read->undo);
+        *move = liberties[0];
+        return 1;
+    }
+    if(depth <= 0 || read->nodes >= TACTICS_MAX_NODES) return 0;
+    for(i = 0; i < n; i++) {
+        // extending to the other liberty would give three liberties or more
+        if(tactics_open(board, liberties[1 - i], liberties[i]) >= 3) continue;
+        if(!tactics_play(read, liberties[i], attacker)) continue;
+        // an atari that captured stones around the group may have given it liberties
+        captured = tactics_libs(board, read->place) == 1 && !tactics_defend(read, depth - 1, &reply);
+        board_unmake_move(board, read->undo);
+        if(captured) {
+            *move = liberties[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// defender to move with the group in atari, returns 1 when it escapes by
+// capturing a neighbour or by extending, a reading that runs out of nodes
+// takes the group as alive
+static int tactics_defend(TACTICS_READ *read, int depth, int *move) {
+    BOARD *board = read->board;
+    int candidates[TACTICS_MAX_DEFENCES + 1], liberty, n, i, libs, reply, saved;
+    *move = -1;
+    if(read->nodes >= TACTICS_MAX_NODES) return 1;
+    n = tactics_counter_captures(board, read->place, candidates, TACTICS_MAX_DEFENCES);
+    if(tactics_liberties(board, read->place, &liberty, 1) == 1) n = tactics_add(candidates, n, liberty);
+    for(i = 0; i < n; i++) {
+        if(!tactics_play(read, candidates[i], read->target)) continue;
+        libs = tactics_libs(board, read->place);
+        saved = libs > 2 || (libs == 2 && !tactics_attack(read, depth - 1, &reply));
+        board_unmake_move(board, read->undo);
+        if(saved) {
+            *move = candidates[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void tactics_cache_clear(TACTICS_CACHE *cache) {
+    memset(cache, 0, sizeof(TACTICS_CACHE));
+}
+
+// whether the group at place is captured when color moves first, for the
+// attacker *move is the capturing move, for the defender the saving one, -1 if
+// there is none; readings that give up count as alive, so a capture is certain
+int tactics_capture(BOARD *board, UNDO_STACK *undo, TACTICS_CACHE *cache, int place, CELL_COLOR color, int *move) {
+    TACTICS_READ read;
+    TACTICS_ENTRY *entry = NULL;
+    uint64_t key;
+    int captured;
+    *move = -1;
+    if(place < 0 || place >= board->square || board->cells[place].color == EMPTY) return 0;
+    place = board->groups.head[place];
+    if(cache) {
+        key = board_key(board) ^ ((uint64_t)(place * 2 + color + 1) * 0x9E3779B97F4A7C15ULL);
+        entry = cache->entries + (key & (TACTICS_CACHE_SIZE - 1));
+        if(entry->key == key) {
+            STAT_ADD(tactics_hits, 1);
+            *move = entry->move;
+            return entry->captured;
+        }
+    }
+    STAT_ADD(tactics_reads, 1);
+    read.board = board;
+    read.undo = undo;
+    read.place = place;
+    read.target = board->cells[place].color;
+    read.nodes = 0;
+    if(color != read.target) captured = tactics_attack(&read, TACTICS_MAX_DEPTH, move);
+    else if(tactics_libs(board, place) == 1) captured = !tactics_defend(&read, TACTICS_MAX_DEPTH, move);
+    else captured = 0;
+    if(entry) {
+        entry->key = key;
+        entry->move = *move;
+        entry->captured = captured;
+    }
+    return captured;
+}
+
+// whether a move at the empty point can touch a group the reader would look
+// at: a neighbour with at most three liberties, or a stone with at most two
+int tactics_near(BOARD *board, int place) {
+    int around[4], i, k, empty = 0;
+    k = tactics_neighbours(board, place, around);
+    for(i = 0; i < k; i++) {
+        if(board->cells[around[i]].color == EMPTY) empty++;
+        else if(tactics_libs(board, around[i]) <= 3) return 1;
+    }
+    return empty <= 2;
+}
+
+// stones color loses and wins around its move at place once the opponent,
+// who is to move, plays the fights out: the opponent takes the biggest of the
+// groups of color it can capture, and each of its groups in atari that can't
+// escape is lost; groups away from the move are left to the static rating
+void tactics_balance(BOARD *board, UNDO_STACK *undo, TACTICS_CACHE *cache, CELL_COLOR color, int place, int *my_lost, int *op_lost) {
+    GROUP_STATE *groups = &board->groups;
+    CELL_COLOR other = color == BLACK ? WHITE : BLACK;
+    int heads[5], around[4], head, move, i, k, n = 0;
+    *my_lost = 0;
+    *op_lost = 0;
+    if(board->cells[place].color != EMPTY) heads[n++] = groups->head[place];
+    k = tactics_neighbours(board, place, around);
+    for(i = 0; i < k; i++) {
+        if(board->cells[around[i]].color != EMPTY) n = tactics_add(heads, n, groups->head[around[i]]);
+    }
+    for(i = 0; i < n; i++) {
+        head = heads[i];
+        if(board->cells[head].color == color) {
+            if(groups->liberties[head] <= 2 && groups->stones[head] > *my_lost
+            && tactics_capture(board, undo, cache, head, other, &move)) *my_lost = groups->stones[head];
+        } else if(groups->liberties[head] == 1 && tactics_capture(board, undo, cache, head, other, &move)) {
+            *op_lost += groups->stones[head];
+        }
+    }
+}
+
+// moves for color that capture an enemy group the reader can't save or save
+// an own group in atari, up to max, returns their number
+int tactics_urgent(BOARD *board, UNDO_STACK *undo, TACTICS_CACHE *cache, CELL_COLOR color, short *out, int max) {
+    GROUP_STATE *groups = &board->groups;
+    int head, move, captured, i, n = 0;
+    for(head = 0; head < board->square && n < max; head++) {
+        if(board->cells[head].color == EMPTY || groups->head[head] != head) continue;
+        if(board->cells[head].color == color) {
+            if(groups->liberties[head] != 1) continue;
+            captured = tactics_capture(board, undo, cache, head, color, &move);
+            if(captured) continue;
+        } else {
+            if(groups->liberties[head] > 2) continue;
+            captured = tactics_capture(board, undo, cache, head, color, &move);
+            if(!captured) continue;
+        }
+        if(move < 0) continue;
+        for(i = 0; i < n && out[i] != move; i++);
+        if(i == n) out[n++] = move;
+    }
+    return n;
+}
@@ -0,0 +1,26 @@
+#ifndef __S80_GUS_TACTICS__
+#define __S80_GUS_TACTICS__
+#include <stdint.h>
+#include "ai.h"
+
+#define TACTICS_MAX_DEPTH (4 * MAX_BOARD)  // plies one reading may go, a ladder takes four per diagonal step
+#define TACTICS_MAX_NODES 200   // moves one reading may try before it gives up
+#define TACTICS_CACHE_SIZE 1024 // entries, a power of two
+
+typedef struct tactics_entry {
+    uint64_t key;
+    short move;
+    short captured;
+} TACTICS_ENTRY;
+
+// results of earlier readings, owned by one search thread
+typedef struct tactics_cache {
+    TACTICS_ENTRY entries[TACTICS_CACHE_SIZE];
+} TACTICS_CACHE;
+
+void tactics_cache_clear(TACTICS_CACHE *cache);
+int  tactics_capture(BOARD *board, UNDO_STACK *undo, TACTICS_CACHE *cache, int place, CELL_COLOR color, int *move);
+int  tactics_near(BOARD *board, int place);
+void tactics_balance(BOARD *board, UNDO_STACK *undo, TACTICS_CACHE *cache, CELL_COLOR color, int place, int *my_lost, int *op_lost);
+int  tactics_urgent(BOARD *board, UNDO_STACK *undo, TACTICS_CACHE *cache, CELL_COLOR color, short *out, int max);
+#endif
@@ -0,0 +1,78 @@
+#include <string.h>
+#include "tt.h"
+#include "ai.h"
+
+static TT_ENTRY *table = NULL;
+static uint64_t table_mask = 0;
+static int generation = 0;
+static TT_STATS stats;
+
+int tt_init(size_t bytes) {
+    uint64_t n = 1;
+    tt_release();
+    while(n * 2 * sizeof(TT_ENTRY) <= bytes) n *= 2;
+    table = (TT_ENTRY*)allocate(NULL, n * sizeof(TT_ENTRY));
+    if(!table) return -1;
+    table_mask = n - 1;
+    tt_clear();
+    return 0;
+}
+
+// empties the table and its counters, keeps the memory
+void tt_clear() {
+    if(!table) return;
+    memset(table, 0, (table_mask + 1) * sizeof(TT_ENTRY));
+    memset(&stats, 0, sizeof(stats));
+    stats.entries = table_mask + 1;
+}
+
+void tt_release() {
+    if(table) allocate(table, 0);
+    table = NULL;
+    table_mask = 0;
+}
+
+int tt_probe(uint64_t key, TT_DATA *out) {
+    TT_ENTRY *entry;
+    uint64_t rating, meta, check;
+    if(!table) return 0;
+    entry = table + (key & table_mask);
+    check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+    rating = __atomic_load_n(&entry->rating, __ATOMIC_RELAXED);
+    meta = __atomic_load_n(&entry->meta, __ATOMIC_RELAXED);
+    if((check ^ rating ^ meta) != key) return 0;
+    memcpy(&out->rating, &rating, sizeof(double));
+    out->best = (short)(meta & 0xFFFF);
+    out->ply = (meta >> 16) & 0xFF;
+    out->generation = (meta >> 24) & 0xFFFF;
+    return 1;
+}
+
+void tt_store(uint64_t key, double rating, int best, int ply, int generation) {
+    TT_ENTRY *entry;
+    uint64_t bits, meta;
+    if(!table) return;
+    entry = table + (key & table_mask);
+    memcpy(&bits, &rating, sizeof(double));
+    meta = (uint64_t)(unsigned short)best | ((uint64_t)(ply & 0xFF) << 16) | ((uint64_t)(generation & 0xFFFF) << 24);
+    __atomic_store_n(&entry->check, key ^ bits ^ meta, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->rating, bits, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->meta, meta, __ATOMIC_RELAXED);
+}
+
+int tt_next_generation() {
+    return __atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED) & 0xFFFF;
+}
+
+// searches count locally and publish once, keeps probes free of shared writes
+void tt_account(TT_STATS *delta) {
+    __atomic_fetch_add(&stats.probes, delta->probes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.hits, delta->hits, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.stores, delta->stores, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.saved_ratings, delta->saved_ratings, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.saved_nodes, delta->saved_nodes, __ATOMIC_RELAXED);
+}
+
+void tt_stats(TT_STATS *out) {
+    memcpy(out, &stats, sizeof(stats));
+}
@@ -0,0 +1,39 @@
+#ifndef __S80_GUS_TT__
+#define __S80_GUS_TT__
+#include <stdlib.h>
+#include <stdint.h>
+
+// move, ply and generation packed next to the rating, every entry is verified
+// by xor-ing all words with the key so that torn writes from concurrent
+// searches are detected as misses instead of returning mixed data
+typedef struct tt_entry {
+    uint64_t check;
+    uint64_t rating;
+    uint64_t meta;
+} TT_ENTRY;
+
+typedef struct tt_data {
+    double rating;
+    short best;
+    unsigned char ply;
+    unsigned short generation;
+} TT_DATA;
+
+typedef struct tt_stats {
+    uint64_t entries;
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t stores;
+    uint64_t saved_ratings;
+    uint64_t saved_nodes;
+} TT_STATS;
+
+int  tt_init(size_t bytes);
+void tt_release();
+void tt_clear();
+int  tt_probe(uint64_t key, TT_DATA *out);
+void tt_store(uint64_t key, double rating, int best, int ply, int generation);
+int  tt_next_generation();
+void tt_account(TT_STATS *delta);
+void tt_stats(TT_STATS *out);
+#endif